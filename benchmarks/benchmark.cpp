@@ -0,0 +1,658 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Usage: multithread_task_benchmark [--threads N] [--quick] [--label TEXT] [--output FILE]
+// Results are written as a single JSON object so that runs from different commits can be compared.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <initializer_list>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "as/multithread_task/thread_pool.hpp"
+#include "as/multithread_task/task_group.hpp"
+#include "as/multithread_task/parallel_for.hpp"
+#include "as/multithread_task/parallel_algorithms.hpp"
+#include "as/multithread_task/parallel_for_tiled.hpp"
+#include "as/multithread_task/enumerable_thread_specific.hpp"
+#include "as/multithread_task/scratch_arena.hpp"
+#include "as/multithread_task/pipeline.hpp"
+#include "as/multithread_task/trace.hpp"
+#include "as/multithread_task/co_task.hpp"
+
+namespace {
+	typedef std::chrono::steady_clock clock_type;
+	typedef std::initializer_list<std::pair<const char*, size_t>> parameters;
+
+	double elapsed_ns(clock_type::time_point aBegin, clock_type::time_point aEnd) {
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(aEnd - aBegin).count());
+	}
+
+	double percentile(std::vector<double>& aSamples, double aPercentile) {
+		std::sort(aSamples.begin(), aSamples.end());
+		const size_t index = static_cast<size_t>(aPercentile / 100.0 * static_cast<double>(aSamples.size() - 1) + 0.5);
+		return aSamples[index];
+	}
+
+	std::string escape(const std::string& aString) {
+		std::string tmp;
+		for(char c : aString) {
+			if(c == '"' || c == '\\') tmp += '\\';
+			tmp += c;
+		}
+		return tmp;
+	}
+
+	/*!
+		\brief Writes benchmark results as JSON.
+	*/
+	class result_writer {
+	private:
+		std::ostream& mStream;
+		bool mFirst;
+	public:
+		result_writer(std::ostream& aStream, const std::string& aLabel, size_t aThreads) :
+			mStream(aStream),
+			mFirst(true)
+		{
+			mStream << "{\n\t\"library\": \"multithread_task\",\n\t\"label\": \"" << escape(aLabel) << "\",\n";
+			mStream << "\t\"hardware_concurrency\": " << std::thread::hardware_concurrency() << ",\n";
+			mStream << "\t\"max_threads\": " << aThreads << ",\n\t\"results\": [";
+		}
+
+		~result_writer() {
+			mStream << "\n\t]\n}\n";
+			mStream.flush();
+		}
+
+		void add(const char* aBenchmark, parameters aParameters, const char* aMetric, double aValue, const char* aUnit) {
+			mStream << (mFirst ? "\n" : ",\n") << "\t\t{\"benchmark\": \"" << aBenchmark << "\"";
+			for(const std::pair<const char*, size_t>& i : aParameters) mStream << ", \"" << i.first << "\": " << i.second;
+			mStream << ", \"metric\": \"" << aMetric << "\", \"value\": " << aValue << ", \"unit\": \"" << aUnit << "\"}";
+			mFirst = false;
+			// Progress for whoever is watching the terminal, stdout may be the JSON file
+			std::fprintf(stderr, "%s %s = %g %s\n", aBenchmark, aMetric, aValue, aUnit);
+		}
+	};
+
+	class counter_task : public as::task<void> {
+	private:
+		std::atomic_size_t& mCounter;
+	protected:
+		void on_execute(as::task_controller&) override {
+			mCounter.fetch_add(1, std::memory_order_relaxed);
+			set_return();
+		}
+
+		void on_resume(as::task_controller&, uint8_t) override {}
+	public:
+		counter_task(std::atomic_size_t& aCounter) :
+			mCounter(aCounter)
+		{}
+	};
+
+	class latency_task : public as::task<int64_t> {
+	private:
+		const clock_type::time_point mScheduled;
+	protected:
+		void on_execute(as::task_controller&) override {
+			set_return(std::chrono::duration_cast<std::chrono::nanoseconds>(clock_type::now() - mScheduled).count());
+		}
+
+		void on_resume(as::task_controller&, uint8_t) override {}
+	public:
+		latency_task(clock_type::time_point aScheduled) :
+			mScheduled(aScheduled)
+		{}
+	};
+
+	/*!
+		\brief Exercises pause, resume and cancel, which can only be called from inside an executing task.
+	*/
+	class control_task : public as::task<void> {
+	public:
+		enum mode {
+			MODE_GATE,		//!< Occupy the worker until released.
+			MODE_VICTIM,	//!< Wait in the queue to be cancelled.
+			MODE_CANCEL,	//!< Cancel every victim.
+			MODE_PAUSE		//!< Pause and resume a number of times.
+		};
+	private:
+		const mode mMode;
+		std::atomic_bool* const mRelease;
+		std::vector<std::shared_ptr<control_task>>* const mVictims;
+		size_t mPauses;
+		size_t mCancelled;
+	protected:
+		void on_execute(as::task_controller& aController) override {
+			switch(mMode) {
+			case MODE_GATE:
+				while(! mRelease->load()) std::this_thread::yield();
+				break;
+			case MODE_CANCEL:
+				for(std::shared_ptr<control_task>& i : *mVictims) if(i->cancel(aController)) ++mCancelled;
+				break;
+			case MODE_PAUSE:
+				on_resume(aController, 0);
+				return;
+			default:
+				break;
+			}
+			set_return();
+		}
+
+		void on_resume(as::task_controller& aController, uint8_t) override {
+			if(mPauses > 0) {
+				--mPauses;
+				if(pause(aController, 0)) return;
+			}
+			set_return();
+		}
+	public:
+		control_task(mode aMode, std::atomic_bool* aRelease = nullptr, std::vector<std::shared_ptr<control_task>>* aVictims = nullptr, size_t aPauses = 0) :
+			mMode(aMode),
+			mRelease(aRelease),
+			mVictims(aVictims),
+			mPauses(aPauses),
+			mCancelled(0)
+		{}
+
+		size_t get_cancelled() const throw() {
+			return mCancelled;
+		}
+	};
+
+	std::vector<size_t> thread_counts(size_t aMax) {
+		std::vector<size_t> tmp;
+		for(size_t i = 1; i < aMax; i *= 2) tmp.push_back(i);
+		tmp.push_back(aMax);
+		return tmp;
+	}
+
+	void benchmark_throughput(result_writer& aResults, size_t aThreads, size_t aTasks) {
+		as::thread_pool pool(aThreads);
+		for(size_t producers : thread_counts(aThreads)) {
+			std::atomic_size_t counter(0);
+			const size_t perProducer = aTasks / producers;
+			const size_t total = perProducer * producers;
+
+			const clock_type::time_point begin = clock_type::now();
+			std::vector<std::thread> threads;
+			for(size_t i = 0; i < producers; ++i) {
+				threads.push_back(std::thread([&]() {
+					for(size_t j = 0; j < perProducer; ++j) pool.schedule_handle<void>(as::make_task<counter_task>(counter));
+				}));
+			}
+			for(std::thread& i : threads) i.join();
+			while(counter.load() < total) std::this_thread::yield();
+			const clock_type::time_point end = clock_type::now();
+
+			aResults.add("empty_task_throughput", {{"threads", aThreads}, {"producers", producers}, {"tasks", total}}, "throughput", static_cast<double>(total) / (elapsed_ns(begin, end) / 1e9), "tasks/s");
+		}
+	}
+
+	void benchmark_submit(result_writer& aResults, size_t aThreads, size_t aTasks, size_t aRepeats) {
+		as::thread_pool pool(aThreads);
+		// A task class against the same work submitted as a lambda, with and without a handle
+		for(size_t mode = 0; mode < 3; ++mode) {
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				std::atomic_size_t counter(0);
+				const clock_type::time_point begin = clock_type::now();
+				for(size_t i = 0; i < aTasks; ++i) {
+					if(mode == 0) {
+						pool.schedule_handle<void>(as::make_task<counter_task>(counter));
+					}else if(mode == 1) {
+						pool.submit([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+					}else {
+						pool.post([&counter]() { counter.fetch_add(1, std::memory_order_relaxed); });
+					}
+				}
+				while(counter.load() < aTasks) std::this_thread::yield();
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			aResults.add(mode == 0 ? "schedule_task_class" : mode == 1 ? "submit_lambda" : "post_lambda", {{"threads", aThreads}, {"tasks", aTasks}}, "time_per_task", percentile(times, 50.0) / static_cast<double>(aTasks), "ns");
+		}
+	}
+
+	void benchmark_latency(result_writer& aResults, size_t aThreads, size_t aSamples) {
+		as::thread_pool pool(aThreads);
+		for(size_t idle = 0; idle < 2; ++idle) {
+			std::vector<double> samples;
+			samples.reserve(aSamples);
+			for(size_t i = 0; i < aSamples; ++i) {
+				// With a gap between tasks the workers have time to park, otherwise they are still spinning
+				if(idle) std::this_thread::sleep_for(std::chrono::microseconds(500));
+				const as::task_handle<int64_t> handle = pool.schedule_handle<int64_t>(as::make_task<latency_task>(clock_type::now()));
+				handle.wait();
+				samples.push_back(static_cast<double>(handle.get()));
+			}
+
+			const char* const name = idle ? "schedule_to_start_latency_idle" : "schedule_to_start_latency_busy";
+			aResults.add(name, {{"threads", aThreads}, {"samples", aSamples}}, "p50", percentile(samples, 50.0), "ns");
+			aResults.add(name, {{"threads", aThreads}, {"samples", aSamples}}, "p90", percentile(samples, 90.0), "ns");
+			aResults.add(name, {{"threads", aThreads}, {"samples", aSamples}}, "p99", percentile(samples, 99.0), "ns");
+			aResults.add(name, {{"threads", aThreads}, {"samples", aSamples}}, "p999", percentile(samples, 99.9), "ns");
+		}
+	}
+
+	void benchmark_parallel_for(result_writer& aResults, size_t aThreads, size_t aElements, size_t aRepeats) {
+		std::vector<float> data(aElements, 1.f);
+		const auto body = [&data](size_t i) {
+			data[i] = std::sqrt(data[i] * 1.0001f + 1.f);
+		};
+
+		std::vector<double> serial;
+		for(size_t r = 0; r < aRepeats; ++r) {
+			const clock_type::time_point begin = clock_type::now();
+			for(size_t i = 0; i < aElements; ++i) body(i);
+			serial.push_back(elapsed_ns(begin, clock_type::now()));
+		}
+		const double serialTime = percentile(serial, 50.0);
+		aResults.add("parallel_for_less_than", {{"threads", 0}, {"blocks", 0}, {"elements", aElements}}, "median_time", serialTime / 1e6, "ms");
+
+		for(size_t threads : thread_counts(aThreads)) {
+			as::thread_pool pool(threads);
+			for(size_t blocks = 1; blocks <= 64; blocks *= 2) {
+				std::vector<double> times;
+				for(size_t r = 0; r < aRepeats; ++r) {
+					const clock_type::time_point begin = clock_type::now();
+					as::parallel_for_less_than<size_t>(pool, 0, aElements, body, static_cast<uint8_t>(blocks));
+					times.push_back(elapsed_ns(begin, clock_type::now()));
+				}
+				const double time = percentile(times, 50.0);
+				aResults.add("parallel_for_less_than", {{"threads", threads}, {"blocks", blocks}, {"elements", aElements}}, "median_time", time / 1e6, "ms");
+				aResults.add("parallel_for_less_than", {{"threads", threads}, {"blocks", blocks}, {"elements", aElements}}, "speedup", serialTime / time, "x");
+			}
+		}
+	}
+
+	void benchmark_parallel_algorithms(result_writer& aResults, size_t aThreads, size_t aElements, size_t aRepeats) {
+		std::vector<uint32_t> input(aElements);
+		uint32_t seed = 1;
+		for(uint32_t& i : input) {
+			seed = seed * 1664525u + 1013904223u;
+			i = seed;
+		}
+		std::vector<uint32_t> data(aElements);
+		std::vector<uint64_t> sums(aElements);
+
+		as::thread_pool pool(aThreads);
+		for(size_t parallel = 0; parallel < 2; ++parallel) {
+			std::vector<double> sortTimes;
+			std::vector<double> scanTimes;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				data = input;
+				clock_type::time_point begin = clock_type::now();
+				if(parallel) as::parallel_sort(pool, data.begin(), data.end());
+				else std::sort(data.begin(), data.end());
+				sortTimes.push_back(elapsed_ns(begin, clock_type::now()));
+
+				begin = clock_type::now();
+				if(parallel) as::parallel_inclusive_scan(pool, input.begin(), input.end(), sums.begin());
+				else std::partial_sum(input.begin(), input.end(), sums.begin(), std::plus<uint64_t>());
+				scanTimes.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			const size_t threads = parallel ? aThreads : 0;
+			aResults.add("sort", {{"threads", threads}, {"elements", aElements}}, "median_time", percentile(sortTimes, 50.0) / 1e6, "ms");
+			aResults.add("inclusive_scan", {{"threads", threads}, {"elements", aElements}}, "median_time", percentile(scanTimes, 50.0) / 1e6, "ms");
+		}
+	}
+
+	void benchmark_parallel_for_2d(result_writer& aResults, size_t aThreads, size_t aSide, size_t aRepeats) {
+		// A transpose reads along columns, so row blocks touch a new cache line for every element they write
+		std::vector<float> input(aSide * aSide, 1.f);
+		std::vector<float> output(aSide * aSide);
+		as::thread_pool pool(aThreads);
+
+		for(size_t tiled = 0; tiled < 2; ++tiled) {
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				const clock_type::time_point begin = clock_type::now();
+				if(tiled) {
+					as::parallel_for_2d(pool, 0, aSide, 0, aSide, [&](size_t aXBegin, size_t aXEnd, size_t aYBegin, size_t aYEnd) {
+						for(size_t y = aYBegin; y < aYEnd; ++y) for(size_t x = aXBegin; x < aXEnd; ++x) output[y * aSide + x] = input[x * aSide + y];
+					});
+				}else {
+					as::parallel_for_less_than<size_t>(pool, 0, aSide, [&](size_t y) {
+						for(size_t x = 0; x < aSide; ++x) output[y * aSide + x] = input[x * aSide + y];
+					}, as::parallel_for_schedule::automatic());
+				}
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			aResults.add(tiled ? "transpose_tiled" : "transpose_rows", {{"threads", aThreads}, {"side", aSide}}, "median_time", percentile(times, 50.0) / 1e6, "ms");
+		}
+	}
+
+	void benchmark_task_group(result_writer& aResults, size_t aThreads, size_t aRepeats) {
+		as::thread_pool pool(aThreads);
+		for(size_t tasks = 16; tasks <= 4096; tasks *= 16) {
+			std::atomic_size_t counter(0);
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				const clock_type::time_point begin = clock_type::now();
+				as::task_group group;
+				for(size_t i = 0; i < tasks; ++i) group.add<void>(as::make_task<counter_task>(counter));
+				group.schedule(pool);
+				group.wait();
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			const double time = percentile(times, 50.0);
+			aResults.add("task_group_fan_out_fan_in", {{"threads", aThreads}, {"tasks", tasks}}, "median_round_time", time / 1e3, "us");
+			aResults.add("task_group_fan_out_fan_in", {{"threads", aThreads}, {"tasks", tasks}}, "time_per_task", time / static_cast<double>(tasks), "ns");
+		}
+	}
+
+	void benchmark_pipeline(result_writer& aResults, size_t aThreads, size_t aItems) {
+		as::thread_pool pool(aThreads);
+		for(size_t tokens = 1; tokens <= aThreads * 4; tokens *= 4) {
+			// parse -> transform -> serialise, with only the transform free to run in parallel
+			as::pipeline pipeline(tokens);
+			size_t next = 0;
+			uint64_t checksum = 0;
+			pipeline.source([&](as::pipeline::flow_control& aControl) -> std::string {
+				if(next == aItems) aControl.stop();
+				return std::to_string(next++);
+			}).then(as::pipeline::mode::PIPELINE_PARALLEL, [](std::string aRecord) -> uint64_t {
+				uint64_t tmp = std::stoull(aRecord);
+				for(int i = 0; i < 1000; ++i) tmp = tmp * 6364136223846793005ull + 1442695040888963407ull;
+				return tmp;
+			}).then(as::pipeline::mode::PIPELINE_SERIAL_IN_ORDER, [&](uint64_t aValue) {
+				checksum ^= aValue;
+			});
+
+			const clock_type::time_point begin = clock_type::now();
+			pipeline.run(pool);
+			aResults.add("pipeline", {{"threads", aThreads}, {"tokens", tokens}, {"items", aItems}}, "throughput", static_cast<double>(aItems) / (elapsed_ns(begin, clock_type::now()) / 1e9), "items/s");
+		}
+	}
+
+	void benchmark_thread_local(result_writer& aResults, size_t aThreads, size_t aIterations, size_t aRepeats) {
+		as::thread_pool pool(aThreads);
+		const as::parallel_for_schedule schedule = as::parallel_for_schedule::dynamic(64);
+
+		// Each iteration builds a histogram in a temporary buffer, which is either heap allocated or taken from the scratch arena
+		for(size_t arena = 0; arena < 2; ++arena) {
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				std::atomic<uint64_t> checksum(0);
+				const clock_type::time_point begin = clock_type::now();
+				as::parallel_for_less_than<size_t>(pool, 0, aIterations, [&](size_t i) {
+					uint32_t* histogram;
+					std::vector<uint32_t> heap;
+					as::scratch_arena& scratch = as::scratch_arena::local();
+					const as::scratch_arena::scope scope(scratch);
+					if(arena) {
+						histogram = scratch.allocate_array<uint32_t>(256);
+					}else {
+						heap.resize(256);
+						histogram = heap.data();
+					}
+					std::fill(histogram, histogram + 256, 0u);
+					for(size_t j = 0; j < 64; ++j) ++histogram[(i * 2654435761u + j * 40503u) & 255u];
+					checksum.fetch_add(histogram[i & 255u], std::memory_order_relaxed);
+				}, schedule);
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			aResults.add(arena ? "scratch_arena" : "scratch_heap", {{"threads", aThreads}, {"iterations", aIterations}}, "time_per_iteration", percentile(times, 50.0) / static_cast<double>(aIterations), "ns");
+		}
+
+		// Counting with a shared atomic against a per-thread counter that is combined at the end
+		for(size_t local = 0; local < 2; ++local) {
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				std::atomic<uint64_t> shared(0);
+				as::enumerable_thread_specific<uint64_t> counters;
+				const clock_type::time_point begin = clock_type::now();
+				as::parallel_for_less_than<size_t>(pool, 0, aIterations, [&](size_t i) {
+					if(local) counters.local() += i & 1;
+					else shared.fetch_add(i & 1, std::memory_order_relaxed);
+				}, schedule);
+				if(local) shared = counters.combine(0, [](uint64_t a, uint64_t b) { return a + b; });
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			aResults.add(local ? "counter_thread_specific" : "counter_atomic", {{"threads", aThreads}, {"iterations", aIterations}}, "time_per_iteration", percentile(times, 50.0) / static_cast<double>(aIterations), "ns");
+		}
+	}
+
+	void benchmark_bulk(result_writer& aResults, size_t aThreads, size_t aTasks, size_t aRepeats) {
+		as::thread_pool pool(aThreads);
+		for(size_t bulk = 0; bulk < 2; ++bulk) {
+			std::vector<double> times;
+			for(size_t r = 0; r < aRepeats; ++r) {
+				std::atomic_size_t counter(0);
+				std::vector<as::task_dispatcher::task_ptr> tasks;
+				tasks.reserve(aTasks);
+				for(size_t i = 0; i < aTasks; ++i) tasks.push_back(as::make_task<counter_task>(counter));
+
+				const clock_type::time_point begin = clock_type::now();
+				if(bulk) {
+					pool.schedule_bulk(tasks);
+				}else {
+					for(as::task_dispatcher::task_ptr& i : tasks) pool.schedule<void>(i);
+				}
+				while(counter.load() < aTasks) std::this_thread::yield();
+				times.push_back(elapsed_ns(begin, clock_type::now()));
+			}
+			aResults.add(bulk ? "schedule_bulk" : "schedule_individual", {{"threads", aThreads}, {"tasks", aTasks}}, "time_per_task", percentile(times, 50.0) / static_cast<double>(aTasks), "ns");
+		}
+	}
+
+#if defined(__cpp_impl_coroutine)
+	as::co_task<size_t> await_chain(as::task_dispatcher& aDispatcher, size_t aAwaits) {
+		size_t tmp = 0;
+		for(size_t i = 0; i < aAwaits; ++i) tmp += co_await aDispatcher.submit([]()->size_t { return 1; });
+		co_return tmp;
+	}
+
+	void benchmark_coroutine(result_writer& aResults, size_t aThreads, size_t aAwaits, size_t aRepeats) {
+		as::thread_pool pool(aThreads);
+		// Each await suspends the coroutine and schedules it again once the awaited task has completed
+		std::vector<double> times;
+		for(size_t r = 0; r < aRepeats; ++r) {
+			const clock_type::time_point begin = clock_type::now();
+			const as::task_handle<size_t> handle = pool.schedule_handle<size_t>(await_chain(pool, aAwaits));
+			handle.wait();
+			times.push_back(elapsed_ns(begin, clock_type::now()));
+			if(handle.get() != aAwaits) std::fprintf(stderr, "co_await_task returned %zu instead of %zu\n", handle.get(), aAwaits);
+		}
+		aResults.add("co_await_task", {{"threads", aThreads}, {"awaits", aAwaits}}, "time_per_await", percentile(times, 50.0) / static_cast<double>(aAwaits), "ns");
+	}
+#endif
+
+	void benchmark_timers(result_writer& aResults, size_t aThreads, size_t aTimers) {
+		as::thread_pool pool(aThreads);
+
+		// A latency task measures how long after its deadline it started
+		std::vector<as::task_handle<int64_t>> handles;
+		handles.reserve(aTimers);
+		for(size_t i = 0; i < aTimers; ++i) {
+			const std::chrono::microseconds delay(1000 + (i * 37) % 20000);
+			const std::shared_ptr<latency_task> task = as::make_task<latency_task>(clock_type::now() + delay);
+			pool.schedule_after(task, delay);
+			handles.push_back(as::task_handle<int64_t>(task));
+		}
+		std::vector<double> samples;
+		for(as::task_handle<int64_t>& i : handles) {
+			i.wait();
+			samples.push_back(static_cast<double>(i.get()));
+		}
+		aResults.add("timer_lateness", {{"threads", aThreads}, {"timers", aTimers}}, "p50", percentile(samples, 50.0), "ns");
+		aResults.add("timer_lateness", {{"threads", aThreads}, {"timers", aTimers}}, "p99", percentile(samples, 99.0), "ns");
+
+		// Adding and cancelling a timer without it expiring
+		std::atomic_size_t counter(0);
+		std::vector<as::task_dispatcher::task_ptr> tasks;
+		for(size_t i = 0; i < aTimers; ++i) tasks.push_back(as::make_task<counter_task>(counter));
+		const clock_type::time_point begin = clock_type::now();
+		for(as::task_dispatcher::task_ptr& i : tasks) pool.schedule_after(i, std::chrono::seconds(60));
+		for(as::task_dispatcher::task_ptr& i : tasks) pool.cancel(*i);
+		aResults.add("timer_add_cancel", {{"threads", aThreads}, {"timers", aTimers}}, "time_per_timer", elapsed_ns(begin, clock_type::now()) / static_cast<double>(aTimers), "ns");
+	}
+
+	class sleep_task : public as::task<void> {
+	private:
+		const std::chrono::microseconds mDuration;
+	protected:
+		void on_execute(as::task_controller&) override {
+			// Stands in for a task that is blocked on I/O
+			std::this_thread::sleep_for(mDuration);
+			set_return();
+		}
+
+		void on_resume(as::task_controller&, uint8_t) override {}
+	public:
+		sleep_task(std::chrono::microseconds aDuration) :
+			mDuration(aDuration)
+		{}
+	};
+
+	void benchmark_elastic(result_writer& aResults, size_t aThreads, size_t aTasks) {
+		// Threads are started on demand, so an unused pool is cheap
+		clock_type::time_point begin = clock_type::now();
+		{
+			as::thread_pool pool(aThreads);
+		}
+		aResults.add("pool_create_destroy", {{"threads", aThreads}}, "time", elapsed_ns(begin, clock_type::now()) / 1000.0, "us");
+
+		for(size_t elastic = 0; elastic < 2; ++elastic) {
+			as::thread_pool pool(aThreads, elastic ? aThreads * 8 : aThreads);
+			std::vector<as::task_handle<void>> handles;
+			begin = clock_type::now();
+			for(size_t i = 0; i < aTasks; ++i) {
+				handles.push_back(pool.schedule_handle<void>(as::make_task<sleep_task>(std::chrono::microseconds(2000))));
+				std::this_thread::sleep_for(std::chrono::microseconds(200));
+			}
+			for(as::task_handle<void>& i : handles) i.wait();
+			aResults.add(elastic ? "blocking_tasks_elastic" : "blocking_tasks_fixed", {{"threads", aThreads}, {"tasks", aTasks}}, "time", elapsed_ns(begin, clock_type::now()) / 1e6, "ms");
+		}
+	}
+
+	void benchmark_control(result_writer& aResults, size_t aPauses, size_t aCancels) {
+		// A single worker, so that the cost of each operation is measured without contention
+		as::thread_pool pool(1);
+
+		{
+			const std::shared_ptr<control_task> task = as::make_task<control_task>(control_task::MODE_PAUSE, nullptr, nullptr, aPauses);
+			const clock_type::time_point begin = clock_type::now();
+			const as::task_handle<void> handle = pool.schedule_handle<void>(task);
+			handle.wait();
+			aResults.add("pause_resume", {{"threads", 1}, {"pauses", aPauses}}, "time_per_cycle", elapsed_ns(begin, clock_type::now()) / static_cast<double>(aPauses), "ns");
+		}
+
+		{
+			// The gate keeps the worker busy while the victims and the canceller are queued behind it
+			std::atomic_bool release(false);
+			std::vector<std::shared_ptr<control_task>> victims;
+			for(size_t i = 0; i < aCancels; ++i) victims.push_back(as::make_task<control_task>(control_task::MODE_VICTIM));
+			const std::shared_ptr<control_task> canceller = as::make_task<control_task>(control_task::MODE_CANCEL, nullptr, &victims);
+
+			pool.schedule_handle<void>(as::make_task<control_task>(control_task::MODE_GATE, &release));
+			for(std::shared_ptr<control_task>& i : victims) pool.schedule_handle<void>(i, as::task_dispatcher::priority::PRIORITY_LOW);
+			const as::task_handle<void> handle = pool.schedule_handle<void>(canceller, as::task_dispatcher::priority::PRIORITY_HIGH);
+
+			release = true;
+			const clock_type::time_point begin = clock_type::now();
+			handle.wait();
+			const double time = elapsed_ns(begin, clock_type::now());
+			aResults.add("cancel", {{"threads", 1}, {"queued", aCancels}, {"cancelled", canceller->get_cancelled()}}, "time_per_cancel", time / static_cast<double>(aCancels), "ns");
+		}
+	}
+
+	void benchmark_trace(result_writer& aResults, size_t aThreads, size_t aEvents, size_t aTasks) {
+		const std::shared_ptr<counter_task> dummy;
+		for(size_t enabled = 0; enabled < 2; ++enabled) {
+			as::set_trace_enabled(enabled != 0);
+			const clock_type::time_point begin = clock_type::now();
+			for(size_t i = 0; i < aEvents; ++i) as::implementation::trace(as::implementation::TRACE_SCHEDULE, dummy.get());
+			aResults.add("trace_event", {{"enabled", enabled}, {"events", aEvents}}, "time_per_event", elapsed_ns(begin, clock_type::now()) / static_cast<double>(aEvents), "ns");
+		}
+
+		// Every task records a schedule, start and complete event
+		{
+			as::thread_pool pool(aThreads);
+			std::atomic_size_t counter(0);
+			const clock_type::time_point begin = clock_type::now();
+			for(size_t i = 0; i < aTasks; ++i) pool.schedule_handle<void>(as::make_task<counter_task>(counter));
+			while(counter.load() < aTasks) std::this_thread::yield();
+			aResults.add("empty_task_throughput_traced", {{"threads", aThreads}, {"tasks", aTasks}}, "throughput", static_cast<double>(aTasks) / (elapsed_ns(begin, clock_type::now()) / 1e9), "tasks/s");
+		}
+		as::set_trace_enabled(false);
+		as::clear_trace();
+	}
+}
+
+int main(int argc, char** argv) {
+	size_t threads = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+	bool quick = false;
+	std::string label;
+	std::string output;
+
+	for(int i = 1; i < argc; ++i) {
+		if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+			threads = std::max<size_t>(std::strtoul(argv[++i], nullptr, 10), 1);
+		}else if(std::strcmp(argv[i], "--quick") == 0) {
+			quick = true;
+		}else if(std::strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+			label = argv[++i];
+		}else if(std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+			output = argv[++i];
+		}else {
+			std::fprintf(stderr, "Usage: %s [--threads N] [--quick] [--label TEXT] [--output FILE]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::ofstream file;
+	if(! output.empty()) {
+		file.open(output.c_str());
+		if(! file) {
+			std::fprintf(stderr, "Could not open %s\n", output.c_str());
+			return 1;
+		}
+	}
+
+	const size_t scale = quick ? 1 : 10;
+	{
+		result_writer results(output.empty() ? std::cout : file, label, threads);
+		benchmark_throughput(results, threads, 20000 * scale);
+		benchmark_latency(results, threads, 500 * scale);
+		benchmark_submit(results, threads, 10000 * scale, quick ? 3 : 11);
+		benchmark_parallel_for(results, threads, 100000 * scale, quick ? 3 : 11);
+		benchmark_parallel_algorithms(results, threads, 100000 * scale, quick ? 3 : 11);
+		benchmark_parallel_for_2d(results, threads, quick ? 1024 : 4096, quick ? 3 : 11);
+		benchmark_task_group(results, threads, quick ? 3 : 21);
+		benchmark_bulk(results, threads, 1000, quick ? 3 : 21);
+		benchmark_pipeline(results, threads, 10000 * scale);
+		benchmark_thread_local(results, threads, 100000 * scale, quick ? 3 : 11);
+#if defined(__cpp_impl_coroutine)
+		benchmark_coroutine(results, threads, 1000 * scale, quick ? 3 : 11);
+#endif
+		benchmark_timers(results, threads, 1000 * scale);
+		benchmark_elastic(results, threads, 100 * scale);
+		benchmark_control(results, 1000 * scale, 1000 * scale);
+		benchmark_trace(results, threads, 100000 * scale, 20000 * scale);
+	}
+	return 0;
+}
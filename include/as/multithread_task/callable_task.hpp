@@ -0,0 +1,136 @@
+#ifndef ASMITH_CALLABLE_TASK_HPP
+#define ASMITH_CALLABLE_TASK_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "task.hpp"
+#include "task_allocator.hpp"
+
+namespace as {
+	namespace implementation {
+		enum : size_t {
+			CALLABLE_INLINE_SIZE = 64	//!< The largest callable that is stored inside a callable_task.
+		};
+
+		/*!
+			\brief The return type of a callable that is executed as a task.
+			\detail A callable that accepts a task_controller& is passed the controller of the current execution.
+		*/
+		template<class F>
+		using callable_result = typename std::decay<typename std::conditional<
+			std::is_invocable<F&, task_controller&>::value,
+			std::invoke_result<F&, task_controller&>,
+			std::invoke_result<F&>
+		>::type::type>::type;
+
+		template<class F>
+		decltype(auto) invoke_callable(F& aFunction, task_controller& aController) {
+			if constexpr(std::is_invocable<F&, task_controller&>::value) {
+				return aFunction(aController);
+			}else {
+				return aFunction();
+			}
+		}
+
+		/*!
+			\brief A task that executes a callable.
+			\detail Every callable_task<R> has the same size whatever the callable is, so they share one slab size class.
+			Callables of up to CALLABLE_INLINE_SIZE bytes are stored inside the task, larger ones in a separate block from the
+			slab cache. The type of the callable is erased with a table of functions rather than virtual calls, and the callable
+			is never copied or moved after it has been stored, so move-only callables are supported.
+			A callable cannot pause, so the task completes when the callable returns. It is still executed through
+			task_interface::execute, because cancel, continuations and task handles depend on the state changes made there.
+			\tparam R The return type of the task, void to discard the value returned by the callable.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		template<class R>
+		class callable_task final : public task<R> {
+		private:
+			struct operations {
+				void(*mExecute)(callable_task<R>&, task_controller&);	//!< Invoke the callable and set the return value.
+				void(*mDestroy)(void*) throw();						//!< Destroy the callable and release its block.
+			};
+
+			template<class F, bool INLINE>
+			struct callable_operations {
+				static void execute(callable_task<R>& aTask, task_controller& aController) {
+					F& function = *static_cast<F*>(aTask.mCallable);
+					if constexpr(std::is_void<R>::value) {
+						invoke_callable(function, aController);
+						aTask.set_return();
+					}else {
+						aTask.set_return(invoke_callable(function, aController));
+					}
+				}
+
+				static void destroy(void* aCallable) throw() {
+					static_cast<F*>(aCallable)->~F();
+					if(! INLINE) slab_allocator<F>().deallocate(static_cast<F*>(aCallable), 1);
+				}
+
+				static constexpr operations OPERATIONS = { &execute, &destroy };
+			};
+
+			typename std::aligned_storage<CALLABLE_INLINE_SIZE, alignof(std::max_align_t)>::type mStorage;	//!< Holds the callable if it fits.
+			void* mCallable;				//!< The callable, either in mStorage or a separate block.
+			const operations* mOperations;	//!< Executes and destroys the callable.
+		protected:
+			// Inherited from task_interface
+
+			void on_execute(task_controller& aController) override {
+				mOperations->mExecute(*this, aController);
+			}
+
+			void on_resume(task_controller&, uint8_t) override {}
+		public:
+			/*!
+				\brief Create a task.
+				\param aFunction The callable, which is moved or copied into the task.
+				\throw std::bad_alloc If the callable does not fit inside the task and a block could not be allocated for it.
+			*/
+			template<class F, class = typename std::enable_if<! std::is_same<typename std::decay<F>::type, callable_task<R>>::value>::type>
+			explicit callable_task(F&& aFunction) {
+				typedef typename std::decay<F>::type callable;
+				constexpr bool is_inline = sizeof(callable) <= CALLABLE_INLINE_SIZE && alignof(callable) <= alignof(std::max_align_t);
+				if constexpr(is_inline) {
+					mCallable = new(&mStorage) callable(std::forward<F>(aFunction));
+				}else {
+					callable* const tmp = slab_allocator<callable>().allocate(1);
+					try {
+						mCallable = new(tmp) callable(std::forward<F>(aFunction));
+					}catch(...) {
+						slab_allocator<callable>().deallocate(tmp, 1);
+						throw;
+					}
+				}
+				mOperations = &callable_operations<callable, is_inline>::OPERATIONS;
+			}
+
+			~callable_task() {
+				mOperations->mDestroy(mCallable);
+			}
+
+			callable_task(const callable_task&) = delete;
+			callable_task& operator=(const callable_task&) = delete;
+		};
+	}
+}
+
+#endif
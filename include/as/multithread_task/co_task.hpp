@@ -0,0 +1,329 @@
+#ifndef ASMITH_CO_TASK_HPP
+#define ASMITH_CO_TASK_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Coroutines are only available when compiling as C++20, the library itself does not depend on them so everything here is inline
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <optional>
+#include <vector>
+#include "task_dispatcher.hpp"
+#include "task_controller.hpp"
+#include "task_group.hpp"
+
+namespace as {
+	template<class T>
+	class co_task;
+
+	namespace implementation {
+		/*!
+			\brief Suspends a coroutine and schedules it again behind other waiting tasks.
+			\detail The coroutine is scheduled at PRIORITY_LOW for that one time only, so that tasks which are already waiting are
+			executed first, it returns to its own priority the next time it is scheduled.
+		*/
+		struct yield_point {
+			bool await_ready() const throw() {
+				return false;
+			}
+
+			template<class P>
+			void await_suspend(std::coroutine_handle<P> aCoroutine) const throw() {
+				aCoroutine.promise().mYield = true;
+			}
+
+			void await_resume() const throw() {}
+		};
+
+		/*!
+			\brief The part of a coroutine's promise that does not depend on its return type.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		class coroutine_promise_base {
+		public:
+			std::vector<task_dispatcher::task_ptr, slab_allocator<task_dispatcher::task_ptr>> mAwaiting;	//!< The tasks that must complete before the coroutine is resumed.
+			std::exception_ptr mException;																//!< The exception that escaped the coroutine.
+			task_dispatcher* mDispatcher;																//!< The dispatcher that is executing the coroutine.
+			bool mYield;																				//!< True if the coroutine is waiting behind other tasks.
+
+			coroutine_promise_base() :
+				mDispatcher(nullptr),
+				mYield(false)
+			{}
+
+			// The coroutine does not start until its task is executed, and its frame is destroyed with the task
+			std::suspend_always initial_suspend() const throw() {
+				return std::suspend_always();
+			}
+
+			std::suspend_always final_suspend() const throw() {
+				return std::suspend_always();
+			}
+
+			void unhandled_exception() throw() {
+				mException = std::current_exception();
+			}
+
+			template<class R>
+			task_handle_awaiter<R> await_transform(const task_handle<R>& aHandle) {
+				return task_handle_awaiter<R>(aHandle);
+			}
+
+			template<class R>
+			task_handle_awaiter<R> await_transform(const co_task<R>& aTask) {
+				// Child coroutines are executed by the same dispatcher as their parent
+				return task_handle_awaiter<R>(mDispatcher->schedule_handle<R>(aTask.get_task()));
+			}
+
+			task_group_awaiter await_transform(task_group& aGroup);
+
+			yield_point await_transform(yield_point aYield) const throw() {
+				return aYield;
+			}
+		};
+
+		/*!
+			\brief Suspends a coroutine until a scheduled task has completed.
+		*/
+		template<class R>
+		class task_handle_awaiter {
+		private:
+			task_handle<R> mHandle;
+		public:
+			task_handle_awaiter(task_handle<R> aHandle) :
+				mHandle(aHandle)
+			{}
+
+			bool await_ready() const throw() {
+				return mHandle.is_ready();
+			}
+
+			template<class P>
+			void await_suspend(std::coroutine_handle<P> aCoroutine) {
+				aCoroutine.promise().mAwaiting.push_back(mHandle.mTask);
+			}
+
+			R await_resume() const {
+				// A value that cannot be copied is moved out of the task, so only one coroutine may await it
+				if constexpr(std::is_copy_constructible<R>::value) return mHandle.get();
+				else return mHandle.take();
+			}
+		};
+
+		/*!
+			\brief Suspends a coroutine until every scheduled task in a task_group has completed.
+		*/
+		class task_group_awaiter {
+		private:
+			task_group& mGroup;
+		public:
+			task_group_awaiter(task_group& aGroup) :
+				mGroup(aGroup)
+			{}
+
+			bool await_ready() const throw() {
+				for(const std::shared_ptr<task_group::task_wrapper>& i : mGroup.mWrappers) if(! i->is_ready()) return false;
+				return true;
+			}
+
+			template<class P>
+			void await_suspend(std::coroutine_handle<P> aCoroutine) {
+				for(const std::shared_ptr<task_group::task_wrapper>& i : mGroup.mWrappers) {
+					task_dispatcher::task_ptr tmp = i->get_scheduled_task();
+					if(tmp) aCoroutine.promise().mAwaiting.push_back(tmp);
+				}
+			}
+
+			void await_resume() {
+				// Every task has completed, so this only collects the return values
+				mGroup.wait();
+			}
+		};
+
+		inline task_group_awaiter coroutine_promise_base::await_transform(task_group& aGroup) {
+			return task_group_awaiter(aGroup);
+		}
+
+		template<class T>
+		class coroutine_promise : public coroutine_promise_base {
+		public:
+			std::optional<T> mValue;	//!< The value returned by the coroutine.
+
+			co_task<T> get_return_object();
+
+			void return_value(T aValue) {
+				mValue.emplace(std::move(aValue));
+			}
+		};
+
+		template<>
+		class coroutine_promise<void> : public coroutine_promise_base {
+		public:
+			co_task<void> get_return_object();
+
+			void return_void() throw() {}
+		};
+
+		/*!
+			\brief The task that executes a coroutine.
+			\detail When the coroutine awaits a task, its own task is suspended and registered as a continuation of the awaited task.
+			The thread that completes the awaited task schedules the coroutine again, so no worker thread is held while it waits.
+			\tparam T The return type of the coroutine.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		template<class T>
+		class coroutine_task : public task<T>, public task_continuation {
+		private:
+			std::coroutine_handle<coroutine_promise<T>> mCoroutine;	//!< The coroutine, owned by the task.
+			task_dispatcher* mDispatcher;							//!< The dispatcher that last executed the task.
+			size_t mAwaitIndex;										//!< The index of the next awaited task to register with.
+			task_dispatcher::priority mPriority;					//!< The priority the coroutine was first scheduled with.
+
+			void resume(task_controller& aController) {
+				coroutine_promise<T>& promise = mCoroutine.promise();
+				mDispatcher = &aController.get_dispatcher();
+				promise.mDispatcher = mDispatcher;
+
+				mCoroutine.resume();
+				if(! mCoroutine.done()) {
+					this->suspend();
+				}else if(promise.mException) {
+					this->set_exception(promise.mException);
+				}else if constexpr(std::is_void<T>::value) {
+					this->set_return();
+				}else {
+					this->set_return(std::move(*promise.mValue));
+				}
+			}
+
+			void wait_next() throw() {
+				coroutine_promise<T>& promise = mCoroutine.promise();
+
+				// The index is advanced first because on_complete may be called by another thread as soon as the continuation is added
+				while(mAwaitIndex < promise.mAwaiting.size()) {
+					if(task_interface::add_continuation(*promise.mAwaiting[mAwaitIndex++], *this)) return;
+				}
+
+				const task_dispatcher::priority priority = promise.mYield ? task_dispatcher::priority::PRIORITY_LOW : mPriority;
+				promise.mAwaiting.clear();
+				promise.mYield = false;
+				mAwaitIndex = 0;
+				mDispatcher->schedule_handle<T>(std::static_pointer_cast<task<T>>(this->shared_from_this()), priority);
+			}
+		protected:
+			// Inherited from task_interface
+
+			void on_execute(task_controller& aController) override {
+				// Later executions are scheduled by the coroutine itself, which would overwrite the priority after a yield
+				mPriority = this->get_scheduled_priority();
+				resume(aController);
+			}
+
+			void on_resume(task_controller& aController, uint8_t) override {
+				resume(aController);
+			}
+
+			void on_suspended() throw() override {
+				wait_next();
+			}
+
+			bool on_reinitialise() override {
+				// A coroutine cannot be restarted
+				return false;
+			}
+		public:
+			coroutine_task(std::coroutine_handle<coroutine_promise<T>> aCoroutine) :
+				mCoroutine(aCoroutine),
+				mDispatcher(nullptr),
+				mAwaitIndex(0),
+				mPriority(task_dispatcher::priority::PRIORITY_MEDIUM)
+			{}
+
+			~coroutine_task() {
+				mCoroutine.destroy();
+			}
+
+			// Inherited from task_continuation
+
+			void on_complete() throw() override {
+				wait_next();
+			}
+		};
+	}
+
+	/*!
+		\brief Suspend the calling coroutine and schedule it again behind other waiting tasks.
+		\detail Usage: co_await as::yield();
+		\return An object that can only be awaited inside a co_task.
+	*/
+	inline implementation::yield_point yield() throw() {
+		return implementation::yield_point();
+	}
+
+	/*!
+		\brief The return type of a coroutine that is executed as a task.
+		\detail Inside the coroutine co_await can be used on a task_handle, a task_group, another co_task or as::yield().
+		Awaiting suspends the coroutine without blocking the worker thread, and it is resumed on the dispatcher once the awaited
+		tasks have completed. The coroutine does not start until its task is scheduled, and it cannot be reinitialised.
+		\tparam T The return type of the coroutine.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class co_task {
+	public:
+		typedef implementation::coroutine_promise<T> promise_type;
+	private:
+		std::shared_ptr<task<T>> mTask;	//!< The task that executes the coroutine.
+	public:
+		explicit co_task(std::shared_ptr<task<T>> aTask) :
+			mTask(aTask)
+		{}
+
+		/*!
+			\brief Return the task that executes the coroutine.
+			\return The task.
+		*/
+		std::shared_ptr<task<T>> get_task() const throw() {
+			return mTask;
+		}
+
+		operator std::shared_ptr<task<T>>() const throw() {
+			return mTask;
+		}
+
+		operator task_dispatcher::task_ptr() const throw() {
+			return mTask;
+		}
+	};
+
+	namespace implementation {
+		template<class T>
+		co_task<T> coroutine_promise<T>::get_return_object() {
+			return co_task<T>(make_task<coroutine_task<T>>(std::coroutine_handle<coroutine_promise<T>>::from_promise(*this)));
+		}
+
+		inline co_task<void> coroutine_promise<void>::get_return_object() {
+			return co_task<void>(make_task<coroutine_task<void>>(std::coroutine_handle<coroutine_promise<void>>::from_promise(*this)));
+		}
+	}
+}
+
+#endif
+
+#endif
@@ -0,0 +1,206 @@
+#ifndef ASMITH_ENUMERABLE_THREAD_SPECIFIC_HPP
+#define ASMITH_ENUMERABLE_THREAD_SPECIFIC_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include "task_interface.hpp"
+
+namespace as {
+	namespace implementation {
+		/*!
+			\brief Return a small index that identifies the calling thread.
+			\detail Indices are allocated from 0 the first time a thread calls this, and are reused by new threads once the thread
+			that held them has exited, so they stay close to the number of threads that are alive at once.
+			\return The index.
+			\throw std::bad_alloc If the index could not be recorded.
+		*/
+		uint32_t get_thread_slot();
+	}
+
+	/*!
+		\brief Holds a separate copy of a value for each thread that accesses it.
+		\detail Elements are created the first time a thread calls local, so a thread pool worker gets its own element without any
+		locking, and elements can be enumerated afterwards to combine them. Each element is on its own cache line.
+		Looking up the calling thread's element is lock free. Elements are kept until clear is called or the container is destroyed,
+		a thread that reuses the index of an exited thread continues with that thread's element.
+		\tparam T The type of the elements.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class enumerable_thread_specific {
+	private:
+		enum : uint32_t {
+			SEGMENT_COUNT = 32		//!< Segment i holds the elements of indices [2^i - 1, 2^(i + 1) - 1).
+		};
+
+		struct alignas(implementation::CACHE_LINE_SIZE) element {
+			typename std::aligned_storage<sizeof(T), alignof(T)>::type mValue;	//!< Constructed when mConstructed is set.
+			std::atomic_bool mConstructed;										//!< Set by the owning thread once mValue has been constructed.
+		};
+
+		std::atomic<element*> mSegments[SEGMENT_COUNT];	//!< Allocated on demand, and never moved once allocated.
+		const std::function<T()> mInitialiser;			//!< Creates the value of a new element.
+
+		static uint32_t get_segment(uint32_t aIndex) throw() {
+			uint32_t tmp = 0;
+			while((static_cast<uint64_t>(aIndex) + 1) >> (tmp + 1)) ++tmp;
+			return tmp;
+		}
+
+		element& get_element(uint32_t aIndex) {
+			const uint32_t segment = get_segment(aIndex);
+			element* elements = mSegments[segment].load(std::memory_order_acquire);
+			if(! elements) {
+				// Another thread may allocate the same segment at the same time, only one of them is kept
+				element* const tmp = new element[static_cast<size_t>(1) << segment];
+				for(size_t i = 0; i < (static_cast<size_t>(1) << segment); ++i) tmp[i].mConstructed.store(false, std::memory_order_relaxed);
+				if(mSegments[segment].compare_exchange_strong(elements, tmp, std::memory_order_acq_rel)) elements = tmp;
+				else delete[] tmp;
+			}
+			return elements[aIndex - ((static_cast<uint32_t>(1) << segment) - 1)];
+		}
+
+		static T& get_value(element& aElement) throw() {
+			return *reinterpret_cast<T*>(&aElement.mValue);
+		}
+	public:
+		/*!
+			\brief Create a container whose elements are value initialised.
+		*/
+		enumerable_thread_specific() :
+			mInitialiser([]()->T { return T(); })
+		{
+			for(std::atomic<element*>& i : mSegments) i.store(nullptr, std::memory_order_relaxed);
+		}
+
+		/*!
+			\brief Create a container whose elements are copies of an exemplar.
+			\param aExemplar The value to copy.
+		*/
+		explicit enumerable_thread_specific(const T& aExemplar) :
+			mInitialiser([aExemplar]()->T { return aExemplar; })
+		{
+			for(std::atomic<element*>& i : mSegments) i.store(nullptr, std::memory_order_relaxed);
+		}
+
+		/*!
+			\brief Create a container whose elements are returned by a function.
+			\param aInitialiser Called by each thread to create its element.
+		*/
+		template<class F, class = typename std::enable_if<std::is_invocable_r<T, F>::value>::type>
+		explicit enumerable_thread_specific(F aInitialiser) :
+			mInitialiser(std::move(aInitialiser))
+		{
+			for(std::atomic<element*>& i : mSegments) i.store(nullptr, std::memory_order_relaxed);
+		}
+
+		~enumerable_thread_specific() {
+			clear();
+		}
+
+		enumerable_thread_specific(const enumerable_thread_specific&) = delete;
+		enumerable_thread_specific& operator=(const enumerable_thread_specific&) = delete;
+
+		/*!
+			\brief Return the calling thread's element, creating it if this is the first time the thread has asked for it.
+			\param aExists Set to false if the element was created by this call.
+			\return The element.
+		*/
+		T& local(bool& aExists) {
+			element& e = get_element(implementation::get_thread_slot());
+			aExists = e.mConstructed.load(std::memory_order_relaxed);
+			if(! aExists) {
+				new(&e.mValue) T(mInitialiser());
+				e.mConstructed.store(true, std::memory_order_release);
+			}
+			return get_value(e);
+		}
+
+		/*!
+			\brief Return the calling thread's element, creating it if this is the first time the thread has asked for it.
+			\return The element.
+		*/
+		T& local() {
+			bool exists;
+			return local(exists);
+		}
+
+		/*!
+			\brief Call a function with every element that has been created.
+			\detail Elements created by other threads are only guaranteed to be visible, and their values up to date, once those
+			threads have synchronised with the caller, for example by the tasks that used them completing.
+			\param aFunction Called with a reference to each element.
+		*/
+		template<class F>
+		void for_each(F aFunction) {
+			for(uint32_t i = 0; i < SEGMENT_COUNT; ++i) {
+				element* const elements = mSegments[i].load(std::memory_order_acquire);
+				if(! elements) continue;
+				for(size_t j = 0; j < (static_cast<size_t>(1) << i); ++j) {
+					if(elements[j].mConstructed.load(std::memory_order_acquire)) aFunction(get_value(elements[j]));
+				}
+			}
+		}
+
+		/*!
+			\brief Combine every element that has been created.
+			\param aIdentity The value to start from.
+			\param aReduce Called with the combined value so far and an element, returns the new combined value.
+			\return The combined value.
+		*/
+		template<class R>
+		T combine(T aIdentity, R aReduce) {
+			for_each([&](T& aValue)->void {
+				aIdentity = aReduce(aIdentity, aValue);
+			});
+			return aIdentity;
+		}
+
+		/*!
+			\brief Return the number of elements that have been created.
+			\return The count.
+		*/
+		size_t size() {
+			size_t tmp = 0;
+			for_each([&tmp](T&)->void {
+				++tmp;
+			});
+			return tmp;
+		}
+
+		/*!
+			\brief Destroy every element, no other thread may use the container while this is called.
+		*/
+		void clear() {
+			for(uint32_t i = 0; i < SEGMENT_COUNT; ++i) {
+				element* const elements = mSegments[i].exchange(nullptr, std::memory_order_acq_rel);
+				if(! elements) continue;
+				for(size_t j = 0; j < (static_cast<size_t>(1) << i); ++j) {
+					if(elements[j].mConstructed.load(std::memory_order_acquire)) get_value(elements[j]).~T();
+				}
+				delete[] elements;
+			}
+		}
+	};
+}
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef ASMITH_FUTEX_HPP
+#define ASMITH_FUTEX_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace as {
+	namespace implementation {
+		/*!
+			\brief Block the calling thread while a value is unchanged.
+			\detail Uses futex on Linux and WaitOnAddress on Windows, other platforms fall back to a condition variable.
+			The function may return spuriously, so the caller must check the value again.
+			\param aValue The value to wait on.
+			\param aExpected The thread is only blocked if aValue is equal to this.
+		*/
+		void futex_wait(const std::atomic<uint32_t>&, uint32_t) throw();
+
+		/*!
+			\brief Block the calling thread while a value is unchanged, or until a timeout expires.
+			\detail The function may return spuriously, so the caller must check the value again.
+			\param aValue The value to wait on.
+			\param aExpected The thread is only blocked if aValue is equal to this.
+			\param aTimeout The maximum time to block for.
+		*/
+		void futex_wait_for(const std::atomic<uint32_t>&, uint32_t, std::chrono::nanoseconds) throw();
+
+		/*!
+			\brief Wake one thread that is blocked in futex_wait on a value.
+			\param aValue The value that the thread is waiting on.
+		*/
+		void futex_wake_one(const std::atomic<uint32_t>&) throw();
+
+		/*!
+			\brief Wake up to a number of threads that are blocked in futex_wait on a value.
+			\param aValue The value that the threads are waiting on.
+			\param aCount The maximum number of threads to wake.
+		*/
+		void futex_wake(const std::atomic<uint32_t>&, uint32_t) throw();
+
+		/*!
+			\brief Wake every thread that is blocked in futex_wait on a value.
+			\param aValue The value that the threads are waiting on.
+		*/
+		void futex_wake_all(const std::atomic<uint32_t>&) throw();
+	}
+}
+
+#endif
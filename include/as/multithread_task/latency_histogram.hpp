@@ -0,0 +1,118 @@
+#ifndef ASMITH_LATENCY_HISTOGRAM_HPP
+#define ASMITH_LATENCY_HISTOGRAM_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+namespace as {
+
+	/*!
+		\brief A histogram of durations with power of two buckets.
+		\detail Bucket i counts durations of [2^i, 2^(i+1)) nanoseconds, bucket 0 also counts zero.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class latency_histogram {
+	public:
+		enum {
+			BUCKET_COUNT = 64	//!< The number of buckets.
+		};
+	private:
+		uint64_t mBuckets[BUCKET_COUNT];	//!< The number of durations in each bucket.
+	public:
+		/*!
+			\brief Create an empty histogram.
+		*/
+		latency_histogram() throw();
+
+		/*!
+			\brief Return the bucket that a duration is counted in.
+			\param aNanoseconds The duration.
+			\return The index of the bucket.
+		*/
+		static size_t get_bucket_index(uint64_t) throw();
+
+		/*!
+			\brief Count a duration.
+			\param aDuration The duration.
+		*/
+		void add(std::chrono::nanoseconds) throw();
+
+		/*!
+			\brief Add the counts of another histogram to this one.
+			\param aOther The other histogram.
+		*/
+		void merge(const latency_histogram&) throw();
+
+		/*!
+			\brief Set the count of a bucket.
+			\param aBucket The index of the bucket.
+			\param aCount The number of durations in the bucket.
+		*/
+		void set_bucket(size_t, uint64_t) throw();
+
+		/*!
+			\brief Return the count of a bucket.
+			\param aBucket The index of the bucket.
+			\return The number of durations in the bucket.
+		*/
+		uint64_t get_bucket(size_t) const throw();
+
+		/*!
+			\brief Return the total number of durations that have been counted.
+			\return The count.
+		*/
+		uint64_t get_count() const throw();
+
+		/*!
+			\brief Estimate a percentile.
+			\param aPercentile The percentile, between 0 and 100.
+			\return The upper bound of the bucket that contains the percentile, or zero if the histogram is empty.
+		*/
+		std::chrono::nanoseconds get_percentile(double) const throw();
+	};
+
+	namespace implementation {
+		/*!
+			\brief A latency_histogram that can be updated and read concurrently.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		class atomic_histogram {
+		private:
+			std::atomic<uint64_t> mBuckets[latency_histogram::BUCKET_COUNT];
+		public:
+			atomic_histogram() throw();
+
+			/*!
+				\brief Count a duration.
+				\param aNanoseconds The duration.
+			*/
+			void add(uint64_t) throw();
+
+			/*!
+				\brief Add the current counts to a histogram.
+				\param aHistogram The histogram.
+			*/
+			void add_to(latency_histogram&) const throw();
+		};
+	}
+}
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef ASMITH_MPMC_QUEUE_HPP
+#define ASMITH_MPMC_QUEUE_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+namespace as {
+
+	/*!
+		\brief A bounded lock-free multi-producer / multi-consumer FIFO queue.
+		\detail Each slot carries a sequence number that tells producers and consumers whether it is free or full
+		for the current lap of the ring, so a push or pop is a single compare-and-swap on the head or tail index.
+		\tparam T The type of object stored in the queue.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class mpmc_queue {
+	private:
+		enum {
+			CACHE_LINE = 64
+		};
+
+		struct slot {
+			std::atomic_size_t mSequence;	//!< Equal to the position of the slot when it is free, or position + 1 when it is full.
+			T mValue;						//!< The stored object.
+		};
+
+		const std::unique_ptr<slot[]> mSlots;			//!< The ring buffer.
+		const size_t mMask;								//!< The capacity - 1.
+		alignas(CACHE_LINE) std::atomic_size_t mHead;	//!< The next position to push to.
+		alignas(CACHE_LINE) std::atomic_size_t mTail;	//!< The next position to pop from.
+	public:
+		/*!
+			\brief Create a new queue.
+			\param aCapacity The maximum number of objects in the queue, rounded up to a power of two.
+		*/
+		mpmc_queue(size_t aCapacity) :
+			mSlots(new slot[capacity_for(aCapacity)]),
+			mMask(capacity_for(aCapacity) - 1),
+			mHead(0),
+			mTail(0)
+		{
+			for(size_t i = 0; i <= mMask; ++i) mSlots[i].mSequence.store(i, std::memory_order_relaxed);
+		}
+
+		mpmc_queue(const mpmc_queue&) = delete;
+		mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+		/*!
+			\brief Add an object to the back of the queue.
+			\param aValue The object, it is only moved from if the push succeeds.
+			\return False if the queue is full.
+		*/
+		bool try_push(T& aValue) throw() {
+			size_t position = mHead.load(std::memory_order_relaxed);
+			for(;;) {
+				slot& s = mSlots[position & mMask];
+				const size_t sequence = s.mSequence.load(std::memory_order_acquire);
+				const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position);
+				if(difference == 0) {
+					if(mHead.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						s.mValue = std::move(aValue);
+						s.mSequence.store(position + 1, std::memory_order_release);
+						return true;
+					}
+				}else if(difference < 0) {
+					return false;
+				}else {
+					position = mHead.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/*!
+			\brief Add several objects to the back of the queue with a single reservation.
+			\detail As many consecutive slots as are free, up to aCount, are reserved with one compare-and-swap.
+			\param aCount The number of objects to add.
+			\param aValue Called with the index of each object that is added, in order, and returns the object. It must not throw.
+			\return The number of objects that were added, this is less than aCount if the queue became full.
+		*/
+		template<class F>
+		size_t try_push_bulk(size_t aCount, F aValue) {
+			size_t position = mHead.load(std::memory_order_relaxed);
+			for(;;) {
+				size_t count = 0;
+				while(count < aCount && mSlots[(position + count) & mMask].mSequence.load(std::memory_order_acquire) == position + count) ++count;
+
+				if(count == 0) {
+					const size_t sequence = mSlots[position & mMask].mSequence.load(std::memory_order_acquire);
+					if(static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position) < 0) return 0;
+					position = mHead.load(std::memory_order_relaxed);
+					continue;
+				}
+
+				if(mHead.compare_exchange_weak(position, position + count, std::memory_order_relaxed)) {
+					for(size_t i = 0; i < count; ++i) {
+						slot& s = mSlots[(position + i) & mMask];
+						s.mValue = aValue(i);
+						s.mSequence.store(position + i + 1, std::memory_order_release);
+					}
+					return count;
+				}
+			}
+		}
+
+		/*!
+			\brief Remove the object at the front of the queue.
+			\param aValue Set to the removed object.
+			\return False if the queue is empty.
+		*/
+		bool try_pop(T& aValue) throw() {
+			size_t position = mTail.load(std::memory_order_relaxed);
+			for(;;) {
+				slot& s = mSlots[position & mMask];
+				const size_t sequence = s.mSequence.load(std::memory_order_acquire);
+				const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position + 1);
+				if(difference == 0) {
+					if(mTail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+						aValue = std::move(s.mValue);
+						s.mValue = T();
+						s.mSequence.store(position + mMask + 1, std::memory_order_release);
+						return true;
+					}
+				}else if(difference < 0) {
+					return false;
+				}else {
+					position = mTail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		/*!
+			\brief Return the maximum number of objects in the queue.
+			\return The capacity.
+		*/
+		size_t capacity() const throw() {
+			return mMask + 1;
+		}
+
+		/*!
+			\brief Return the approximate number of objects in the queue.
+			\detail The value may already be out of date if other threads are using the queue.
+			\return The size.
+		*/
+		size_t size() const throw() {
+			const size_t tail = mTail.load(std::memory_order_relaxed);
+			const size_t head = mHead.load(std::memory_order_relaxed);
+			return head > tail ? head - tail : 0;
+		}
+	private:
+		static size_t capacity_for(size_t aCapacity) throw() {
+			size_t tmp = 2;
+			while(tmp < aCapacity) tmp <<= 1;
+			return tmp;
+		}
+	};
+}
+
+#endif
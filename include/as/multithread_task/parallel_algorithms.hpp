@@ -0,0 +1,427 @@
+#ifndef ASMITH_PARALLEL_ALGORITHMS_HPP
+#define ASMITH_PARALLEL_ALGORITHMS_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <functional>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include "parallel_reduce.hpp"
+
+namespace as {
+	namespace implementation {
+		enum : size_t {
+			PARALLEL_SORT_THRESHOLD = 4096,		//!< Ranges with fewer elements are sorted serially.
+			PARALLEL_SCAN_THRESHOLD = 8192,		//!< Ranges with fewer elements are scanned serially.
+			PARALLEL_COPY_THRESHOLD = 1 << 18	//!< Ranges of fewer bytes are filled or copied serially.
+		};
+
+		/*!
+			\brief Return the size of the fixed blocks that an algorithm divides a range into.
+			\detail Algorithms that combine the results of neighbouring blocks need the block edges to be known in advance,
+			so dynamic and guided schedules are turned into blocks of a fixed size.
+			\param aCount The number of elements.
+			\param aSchedule SCHEDULE_STATIC sets the number of blocks, SCHEDULE_DYNAMIC sets the block size,
+			otherwise there is one block for each hardware thread.
+			\return The number of elements in each block, the last block may be smaller.
+		*/
+		inline size_t parallel_block_size(size_t aCount, parallel_for_schedule aSchedule) throw() {
+			const size_t value = std::max<size_t>(aSchedule.get_value(), 1);
+			size_t tmp;
+			switch(aSchedule.get_kind()) {
+			case parallel_for_schedule::SCHEDULE_STATIC:
+				tmp = (aCount + value - 1) / value;
+				break;
+			case parallel_for_schedule::SCHEDULE_DYNAMIC:
+				tmp = value;
+				break;
+			default:
+				{
+					const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+					tmp = std::max((aCount + hardware - 1) / hardware, value);
+				}
+				break;
+			}
+			return std::max<size_t>(tmp, 1);
+		}
+
+		/*!
+			\brief Uninitialised storage for a number of elements, taken from the slab allocator.
+			\detail Elements are constructed by the owner of the buffer, once they are marked as constructed they are destroyed with it.
+		*/
+		template<class T>
+		class slab_buffer {
+		private:
+			T* const mData;			//!< The first element.
+			const size_t mCount;	//!< The number of elements that the buffer can hold.
+			size_t mConstructed;	//!< The number of elements from the start of the buffer that have been constructed.
+		public:
+			explicit slab_buffer(size_t aCount) :
+				mData(slab_allocator<T>().allocate(aCount)),
+				mCount(aCount),
+				mConstructed(0)
+			{}
+
+			~slab_buffer() {
+				std::destroy(mData, mData + mConstructed);
+				slab_allocator<T>().deallocate(mData, mCount);
+			}
+
+			slab_buffer(const slab_buffer&) = delete;
+			slab_buffer& operator=(const slab_buffer&) = delete;
+
+			T* get() const throw() {
+				return mData;
+			}
+
+			void set_constructed(size_t aCount) throw() {
+				mConstructed = aCount;
+			}
+		};
+
+		/*!
+			\brief Call the function at an index of a tuple.
+			\param aFunctions References to the functions.
+			\param aIndex The index of the function to call.
+		*/
+		template<class T, size_t... I>
+		void invoke_at(T& aFunctions, size_t aIndex, std::index_sequence<I...>) {
+			static_cast<void>(std::initializer_list<int>{ (I == aIndex ? (static_cast<void>(std::get<I>(aFunctions)()), 0) : 0)... });
+		}
+
+		/*!
+			\brief Merge the pairs of neighbouring sorted runs in a range, writing the merged runs to another range.
+			\detail The output is divided into chunks that each find where they start in both runs with a binary search along
+			the merge path, so every pass is divided evenly between threads no matter how few runs are left. The searches are
+			all done before any element is moved, as a chunk's search may read elements that another chunk moves.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aFrom The range containing the sorted runs, its elements are moved from.
+			\param aTo The range to write the merged runs to.
+			\param aCount The number of elements.
+			\param aRun The number of elements in each run, the last run may be smaller.
+			\param aChunk The number of output elements in each chunk, aRun must be a multiple of it.
+			\param aCompare The comparison function.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		template<class I1, class I2, class C>
+		void merge_runs(task_dispatcher& aDispatcher, I1 aFrom, I2 aTo, size_t aCount, size_t aRun, size_t aChunk, const C& aCompare, task_dispatcher::priority aPriority) {
+			const size_t chunks = (aCount + aChunk - 1) / aChunk;
+
+			// The number of elements taken from the first run of each chunk's pair before the start and end of the chunk
+			std::vector<std::pair<size_t, size_t>, slab_allocator<std::pair<size_t, size_t>>> splits(chunks);
+			for(size_t i = 0; i < chunks; ++i) {
+				const size_t begin = i * aChunk;
+				const size_t pair = (begin / (aRun * 2)) * (aRun * 2);
+				const size_t middle = std::min(pair + aRun, aCount);
+				const size_t a_size = middle - pair;
+				const size_t b_size = std::min(pair + aRun * 2, aCount) - middle;
+				const I1 a = aFrom + pair;
+				const I1 b = aFrom + middle;
+
+				// Ties are taken from the first run
+				const auto split = [&](size_t aDiagonal)->size_t {
+					size_t low = aDiagonal > b_size ? aDiagonal - b_size : 0;
+					size_t high = std::min(aDiagonal, a_size);
+					while(low < high) {
+						const size_t j = low + (high - low) / 2;
+						if(! aCompare(b[aDiagonal - j - 1], a[j])) low = j + 1;
+						else high = j;
+					}
+					return low;
+				};
+
+				splits[i].first = split(begin - pair);
+				splits[i].second = split(std::min(begin + aChunk, aCount) - pair);
+			}
+
+			parallel_for_chunks(aDispatcher, chunks, parallel_for_schedule::dynamic(1), aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+				for(size_t i = aChunkBegin; i < aChunkEnd; ++i) {
+					const size_t begin = i * aChunk;
+					const size_t end = std::min(begin + aChunk, aCount);
+					const size_t pair = (begin / (aRun * 2)) * (aRun * 2);
+					const I1 a = aFrom + pair;
+					const I1 b = aFrom + std::min(pair + aRun, aCount);
+					std::merge(
+						std::make_move_iterator(a + splits[i].first), std::make_move_iterator(a + splits[i].second),
+						std::make_move_iterator(b + ((begin - pair) - splits[i].first)), std::make_move_iterator(b + ((end - pair) - splits[i].second)),
+						aTo + begin,
+						aCompare
+					);
+				}
+			});
+		}
+
+		/*!
+			\brief Compute a prefix sum in two passes over fixed blocks.
+			\detail The first pass reduces every block but the last, the block totals are then combined serially into the
+			offset of each block, and the second pass scans each block from its offset. aOut may be equal to aBegin.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aBegin The first element.
+			\param aCount The number of elements.
+			\param aOut The first element of the output.
+			\param aInit The value that comes before the first element, or nullptr for an inclusive scan.
+			\param aReduce Combines two values, it must be associative.
+			\param aBlock The number of elements in each block.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		template<class T, class I, class O, class R>
+		void parallel_scan(task_dispatcher& aDispatcher, I aBegin, size_t aCount, O aOut, const T* aInit, const R& aReduce, size_t aBlock, task_dispatcher::priority aPriority) {
+			typedef padded_accumulator<T> accumulator;
+			if(aCount == 0) return;
+			const size_t blocks = (aCount + aBlock - 1) / aBlock;
+
+			// The offsets of blocks 1 to blocks - 1, block 0 starts from aInit
+			std::vector<accumulator, slab_allocator<accumulator>> offsets;
+			const auto scan_block = [&](size_t aIndex)->void {
+				size_t i = aIndex * aBlock;
+				const size_t end = std::min(i + aBlock, aCount);
+				if(aIndex == 0 && ! aInit) {
+					T tmp = aBegin[i];
+					aOut[i] = tmp;
+					for(++i; i < end; ++i) {
+						tmp = aReduce(tmp, aBegin[i]);
+						aOut[i] = tmp;
+					}
+				}else {
+					T tmp = aIndex == 0 ? *aInit : offsets[aIndex - 1].mValue;
+					for(; i < end; ++i) {
+						if(aInit) {
+							// Read before writing, the output may be the input
+							T next = aReduce(tmp, aBegin[i]);
+							aOut[i] = std::move(tmp);
+							tmp = std::move(next);
+						}else {
+							tmp = aReduce(tmp, aBegin[i]);
+							aOut[i] = tmp;
+						}
+					}
+				}
+			};
+
+			if(blocks == 1) {
+				scan_block(0);
+				return;
+			}
+
+			offsets.resize(blocks - 1, accumulator(T(aBegin[0])));
+			parallel_for_chunks(aDispatcher, blocks - 1, parallel_for_schedule::dynamic(1), aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+				for(size_t j = aChunkBegin; j < aChunkEnd; ++j) {
+					size_t i = j * aBlock;
+					const size_t end = i + aBlock;
+					T tmp = aBegin[i];
+					for(++i; i < end; ++i) tmp = aReduce(tmp, aBegin[i]);
+					offsets[j].mValue = std::move(tmp);
+				}
+			});
+
+			if(aInit) offsets[0].mValue = aReduce(*aInit, offsets[0].mValue);
+			for(size_t i = 1; i < blocks - 1; ++i) offsets[i].mValue = aReduce(offsets[i - 1].mValue, offsets[i].mValue);
+
+			parallel_for_chunks(aDispatcher, blocks, parallel_for_schedule::dynamic(1), aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+				for(size_t i = aChunkBegin; i < aChunkEnd; ++i) scan_block(i);
+			});
+		}
+	}
+
+	/*!
+		\brief Call several functions in parallel.
+		\detail Each function after the first is scheduled as a task and the first is called on the calling thread, which then
+		helps execute the others until they have all returned. If a function throws, functions that have not started yet are
+		skipped and the exception is rethrown once the others have returned.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aPriority The priority to schedule the tasks with.
+		\param aFunctions The functions, called with no arguments.
+	*/
+	template<class... F>
+	void parallel_invoke(task_dispatcher& aDispatcher, task_dispatcher::priority aPriority, F&&... aFunctions) {
+		std::tuple<F&...> functions(aFunctions...);
+		implementation::parallel_for_chunks(aDispatcher, sizeof...(F), parallel_for_schedule::static_blocks(sizeof...(F)), aPriority, [&](size_t aBegin, size_t aEnd)->void {
+			for(size_t i = aBegin; i < aEnd; ++i) implementation::invoke_at(functions, i, std::index_sequence_for<F...>());
+		});
+	}
+
+	/*!
+		\brief Call several functions in parallel with PRIORITY_MEDIUM.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aFunctions The functions, called with no arguments.
+		\see parallel_invoke
+	*/
+	template<class... F>
+	void parallel_invoke(task_dispatcher& aDispatcher, F&&... aFunctions) {
+		parallel_invoke(aDispatcher, task_dispatcher::priority::PRIORITY_MEDIUM, std::forward<F>(aFunctions)...);
+	}
+
+	/*!
+		\brief Sort a range in parallel.
+		\detail The range is divided into blocks that are sorted in parallel with std::sort, then neighbouring runs are merged
+		in rounds until one is left. Each merge round is divided evenly between threads, and alternates between the range and
+		a buffer of the same size. The buffer comes from the slab allocator and is move constructed from the range, so the
+		elements only need to be move constructible and move assignable. With aInPlace no buffer is allocated and each pair of
+		runs is merged with std::inplace_merge, which parallelises less in the final rounds. The sort is not stable.
+		Ranges of fewer than 4096 elements are sorted serially.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first random access iterator.
+		\param aEnd One past the last random access iterator.
+		\param aCompare The comparison function.
+		\param aInPlace True if the range should be merged without a buffer.
+		\param aSchedule SCHEDULE_STATIC sets the number of blocks and SCHEDULE_DYNAMIC the block size.
+		\param aPriority The priority to schedule the tasks with.
+	*/
+	template<class I, class C = std::less<>>
+	void parallel_sort(task_dispatcher& aDispatcher, I aBegin, I aEnd, C aCompare = C(), bool aInPlace = false, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		typedef typename std::iterator_traits<I>::value_type value_type;
+
+		const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		const size_t block = implementation::parallel_block_size(count, aSchedule);
+		if(count < implementation::PARALLEL_SORT_THRESHOLD || block >= count) {
+			std::sort(aBegin, aEnd, aCompare);
+			return;
+		}
+
+		const C& compare = aCompare;
+		const size_t blocks = (count + block - 1) / block;
+		implementation::parallel_for_chunks(aDispatcher, blocks, parallel_for_schedule::dynamic(1), aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+			for(size_t i = aChunkBegin; i < aChunkEnd; ++i) std::sort(aBegin + i * block, aBegin + std::min((i + 1) * block, count), compare);
+		});
+
+		if(aInPlace) {
+			for(size_t run = block; run < count; run *= 2) {
+				implementation::parallel_for_chunks(aDispatcher, (count + run * 2 - 1) / (run * 2), parallel_for_schedule::dynamic(1), aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+					for(size_t i = aChunkBegin; i < aChunkEnd; ++i) {
+						const size_t begin = i * run * 2;
+						const size_t middle = std::min(begin + run, count);
+						const size_t end = std::min(begin + run * 2, count);
+						if(middle < end) std::inplace_merge(aBegin + begin, aBegin + middle, aBegin + end, compare);
+					}
+				});
+			}
+			return;
+		}
+
+		// The sorted blocks are moved into the buffer, so that it never holds default constructed elements
+		implementation::slab_buffer<value_type> buffer(count);
+		value_type* const data = buffer.get();
+		std::uninitialized_move(aBegin, aEnd, data);
+		buffer.set_constructed(count);
+
+		bool buffered = true;
+		for(size_t run = block; run < count; run *= 2) {
+			if(buffered) implementation::merge_runs(aDispatcher, data, aBegin, count, run, block, compare, aPriority);
+			else implementation::merge_runs(aDispatcher, aBegin, data, count, run, block, compare, aPriority);
+			buffered = ! buffered;
+		}
+
+		if(buffered) {
+			implementation::parallel_for_chunks(aDispatcher, count, aSchedule, aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+				std::move(data + aChunkBegin, data + aChunkEnd, aBegin + aChunkBegin);
+			});
+		}
+	}
+
+	/*!
+		\brief Compute an inclusive prefix sum in parallel.
+		\detail Element i of the output is the combination of elements 0 to i of the input. The range is divided into fixed blocks,
+		the first pass reduces each block and the second scans each block from the combined total of the blocks before it,
+		so aReduce is called about twice per element and must be associative. Ranges of fewer than 8192 elements are scanned serially.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first random access iterator.
+		\param aEnd One past the last random access iterator.
+		\param aOut The first random access iterator of the output, which may be aBegin.
+		\param aReduce Combines two values.
+		\param aSchedule SCHEDULE_STATIC sets the number of blocks and SCHEDULE_DYNAMIC the block size.
+		\param aPriority The priority to schedule the tasks with.
+		\return One past the last element of the output.
+	*/
+	template<class I, class O, class R = std::plus<>>
+	O parallel_inclusive_scan(task_dispatcher& aDispatcher, I aBegin, I aEnd, O aOut, R aReduce = R(), parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		typedef typename std::iterator_traits<I>::value_type value_type;
+		const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		const size_t block = count < implementation::PARALLEL_SCAN_THRESHOLD ? count : implementation::parallel_block_size(count, aSchedule);
+		implementation::parallel_scan<value_type>(aDispatcher, aBegin, count, aOut, nullptr, aReduce, block, aPriority);
+		return aOut + count;
+	}
+
+	/*!
+		\brief Compute an exclusive prefix sum in parallel.
+		\detail Element i of the output is the combination of aInit and elements 0 to i - 1 of the input.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first random access iterator.
+		\param aEnd One past the last random access iterator.
+		\param aOut The first random access iterator of the output, which may be aBegin.
+		\param aInit The first value of the output.
+		\param aReduce Combines two values.
+		\param aSchedule SCHEDULE_STATIC sets the number of blocks and SCHEDULE_DYNAMIC the block size.
+		\param aPriority The priority to schedule the tasks with.
+		\return One past the last element of the output.
+		\see parallel_inclusive_scan
+	*/
+	template<class I, class O, class T, class R = std::plus<>>
+	O parallel_exclusive_scan(task_dispatcher& aDispatcher, I aBegin, I aEnd, O aOut, T aInit, R aReduce = R(), parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		const size_t block = count < implementation::PARALLEL_SCAN_THRESHOLD ? count : implementation::parallel_block_size(count, aSchedule);
+		implementation::parallel_scan<T>(aDispatcher, aBegin, count, aOut, &aInit, aReduce, block, aPriority);
+		return aOut + count;
+	}
+
+	/*!
+		\brief Assign a value to every element of a range in parallel.
+		\detail Ranges of less than 256 KiB are filled serially. When I is a pointer to elements whose size divides the cache line size, the chunk edges fall on cache line boundaries.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first pointer or random access iterator.
+		\param aEnd One past the last pointer or random access iterator.
+		\param aValue The value to assign.
+		\param aSchedule How elements are divided between threads.
+		\param aPriority The priority to schedule the tasks with.
+	*/
+	template<class I, class T>
+	void parallel_fill(task_dispatcher& aDispatcher, I aBegin, I aEnd, const T& aValue, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		typedef typename std::iterator_traits<I>::value_type value_type;
+		const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		if(count * sizeof(value_type) < implementation::PARALLEL_COPY_THRESHOLD) {
+			std::fill(aBegin, aEnd, aValue);
+			return;
+		}
+		parallel_for_range(aDispatcher, aBegin, aEnd, [&aValue](I aChunkBegin, I aChunkEnd)->void {
+			std::fill(aChunkBegin, aChunkEnd, aValue);
+		}, aSchedule, aPriority);
+	}
+
+	/*!
+		\brief Copy a range in parallel.
+		\detail Ranges of less than 256 KiB are copied serially. The ranges must not overlap.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first pointer or random access iterator.
+		\param aEnd One past the last pointer or random access iterator.
+		\param aOut The first pointer or random access iterator of the output.
+		\param aSchedule How elements are divided between threads.
+		\param aPriority The priority to schedule the tasks with.
+		\return One past the last element of the output.
+	*/
+	template<class I, class O>
+	O parallel_copy(task_dispatcher& aDispatcher, I aBegin, I aEnd, O aOut, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		typedef typename std::iterator_traits<I>::value_type value_type;
+		const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		if(count * sizeof(value_type) < implementation::PARALLEL_COPY_THRESHOLD) return std::copy(aBegin, aEnd, aOut);
+
+		// Chunks are taken from the output so that threads never write to the same cache line
+		parallel_for_range(aDispatcher, aOut, aOut + count, [&](O aChunkBegin, O aChunkEnd)->void {
+			std::copy(aBegin + (aChunkBegin - aOut), aBegin + (aChunkEnd - aOut), aChunkBegin);
+		}, aSchedule, aPriority);
+		return aOut + count;
+	}
+}
+
+#endif
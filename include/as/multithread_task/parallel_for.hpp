@@ -15,10 +15,81 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <vector>
 #include "task_dispatcher.hpp"
 #include "task.hpp"
+#include "task_allocator.hpp"
 
 namespace as {
+
+	/*!
+		\brief Describes how the iterations of a parallel loop are divided between threads.
+		\detail Mirrors the OpenMP schedule clause.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class parallel_for_schedule {
+	public:
+		enum kind {					//!< The scheduling policy.
+			SCHEDULE_STATIC,		//!< The range is split into a fixed number of equal blocks.
+			SCHEDULE_DYNAMIC,		//!< Threads repeatedly claim fixed size chunks until the range is exhausted.
+			SCHEDULE_GUIDED,		//!< Threads repeatedly claim chunks proportional to the remaining iterations, which shrink towards a minimum size.
+			SCHEDULE_AUTO			//!< A dynamic schedule with a chunk size chosen from the hardware concurrency and range size.
+		};
+	private:
+		kind mKind;			//!< The scheduling policy.
+		size_t mValue;		//!< The number of blocks (SCHEDULE_STATIC), chunk size (SCHEDULE_DYNAMIC) or minimum chunk size (SCHEDULE_GUIDED).
+
+		parallel_for_schedule(kind aKind, size_t aValue) :
+			mKind(aKind),
+			mValue(aValue)
+		{}
+	public:
+		/*!
+			\brief Split the range into equal blocks.
+			\param aBlocks The number of blocks.
+		*/
+		static parallel_for_schedule static_blocks(size_t aBlocks) {
+			return parallel_for_schedule(SCHEDULE_STATIC, aBlocks);
+		}
+
+		/*!
+			\brief Claim fixed size chunks from a shared counter.
+			\param aChunk The number of iterations in each chunk.
+		*/
+		static parallel_for_schedule dynamic(size_t aChunk = 1) {
+			return parallel_for_schedule(SCHEDULE_DYNAMIC, aChunk);
+		}
+
+		/*!
+			\brief Claim shrinking chunks from a shared counter.
+			\param aMinChunk The smallest number of iterations in a chunk.
+		*/
+		static parallel_for_schedule guided(size_t aMinChunk = 1) {
+			return parallel_for_schedule(SCHEDULE_GUIDED, aMinChunk);
+		}
+
+		/*!
+			\brief Let the library choose the schedule.
+		*/
+		static parallel_for_schedule automatic() {
+			return parallel_for_schedule(SCHEDULE_AUTO, 0);
+		}
+
+		kind get_kind() const throw() {
+			return mKind;
+		}
+
+		size_t get_value() const throw() {
+			return mValue;
+		}
+	};
+
 	template<class T, class F, class L1, class L2>
 	class parallel_for_task : public task<void> {
 	private:
@@ -46,7 +117,8 @@ namespace as {
 		void on_resume(as::task_controller& aController, uint8_t aLocation) override {
 			while(mCondition(mIndex, mEnd)) {
 #ifndef ASMITH_DISABLE_PARALLEL_FOR_PAUSE
-				if(is_pause_requested()) pause(aController, aLocation);
+				// A paused task has already been queued again, so another thread may resume it as soon as this returns
+				if(is_pause_requested() && pause(aController, aLocation)) return;
 #endif
 				mFunction(mIndex);
 				mIncrement(mIndex);
@@ -57,119 +129,362 @@ namespace as {
 
 	namespace implementation {
 
-		template<class V, class F, class I, class I2, class L1, class L2>
-		void parallel_for(task_dispatcher& aDispatcher, V aMin, V aMax, F aFunction, size_t aBlocks, task_dispatcher::priority aPriority, I aMinFn, I2 aMaxFn, L1 aCondition, L2 aIncrement) {
-			std::future<void>* const futures = new std::future<void>[aBlocks];
-			try{
-				for(size_t i = 0; i < aBlocks; ++i) {
-					task_dispatcher::task_ptr task(new parallel_for_task<V,F,L1,L2>(aMinFn(i), aMaxFn(i), aFunction, aCondition, aIncrement));
-					futures[i] = aDispatcher.schedule<void>(task, aPriority);
+		/*!
+			\brief A parallel_for_schedule resolved for a specific number of iterations.
+		*/
+		struct parallel_for_plan {
+			parallel_for_schedule::kind mKind;	//!< The scheduling policy, never SCHEDULE_AUTO.
+			size_t mValue;						//!< The number of blocks, chunk size or minimum chunk size.
+			size_t mThreads;					//!< The number of threads that claim chunks, including the calling thread.
+
+			parallel_for_plan(size_t aCount, parallel_for_schedule aSchedule) :
+				mKind(aSchedule.get_kind()),
+				mValue(std::max<size_t>(aSchedule.get_value(), 1))
+			{
+				const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+				aCount = std::max<size_t>(aCount, 1);
+
+				switch(mKind) {
+				case parallel_for_schedule::SCHEDULE_STATIC:
+					mValue = std::min(mValue, aCount);
+					mThreads = mValue;
+					break;
+				case parallel_for_schedule::SCHEDULE_AUTO:
+					// Several chunks per thread gives room to balance uneven iterations without claiming too often
+					mKind = parallel_for_schedule::SCHEDULE_DYNAMIC;
+					mValue = std::max<size_t>(aCount / (hardware * 8), 1);
+					mThreads = std::min(hardware, aCount);
+					break;
+				default:
+					mThreads = std::min(hardware, (aCount + mValue - 1) / mValue);
+					break;
+				}
+			}
+		};
+
+		/*!
+			\brief Hands out chunks of a loop's iterations to the threads that execute it.
+		*/
+		class parallel_for_claim {
+		private:
+			std::atomic_size_t mNext;						//!< The next unclaimed iteration (or block for SCHEDULE_STATIC).
+			const size_t mCount;							//!< The number of iterations.
+			const parallel_for_schedule::kind mKind;		//!< The scheduling policy, never SCHEDULE_AUTO.
+			const size_t mValue;							//!< The number of blocks, chunk size or minimum chunk size.
+			const size_t mThreads;							//!< The number of threads that claim chunks.
+		public:
+			parallel_for_claim(size_t aCount, const parallel_for_plan& aPlan) :
+				mNext(0),
+				mCount(aCount),
+				mKind(aPlan.mKind),
+				mValue(aPlan.mValue),
+				mThreads(aPlan.mThreads)
+			{}
+
+			/*!
+				\brief Claim the next chunk of iterations.
+				\param aBegin Set to the first iteration of the chunk.
+				\param aEnd Set to one past the last iteration of the chunk.
+				\return False if there are no iterations left.
+			*/
+			bool claim(size_t& aBegin, size_t& aEnd) throw() {
+				switch(mKind) {
+				case parallel_for_schedule::SCHEDULE_STATIC:
+					{
+						const size_t block = mNext.fetch_add(1, std::memory_order_relaxed);
+						if(block >= mValue) return false;
+						aBegin = (mCount / mValue) * block + std::min(block, mCount % mValue);
+						aEnd = aBegin + (mCount / mValue) + (block < mCount % mValue ? 1 : 0);
+						return true;
+					}
+				case parallel_for_schedule::SCHEDULE_GUIDED:
+					{
+						size_t begin = mNext.load(std::memory_order_relaxed);
+						size_t size;
+						do {
+							if(begin >= mCount) return false;
+							size = std::min(std::max((mCount - begin) / (mThreads * 2), mValue), mCount - begin);
+						}while(! mNext.compare_exchange_weak(begin, begin + size, std::memory_order_relaxed));
+						aBegin = begin;
+						aEnd = begin + size;
+						return true;
+					}
+				default:
+					{
+						// Check first so that the counter cannot wrap around when the loop is over
+						if(mNext.load(std::memory_order_relaxed) >= mCount) return false;
+						aBegin = mNext.fetch_add(mValue, std::memory_order_relaxed);
+						if(aBegin >= mCount) return false;
+						aEnd = std::min(aBegin + mValue, mCount);
+						return true;
+					}
+				}
+			}
+
+			/*!
+				\brief Stop any more chunks from being claimed.
+			*/
+			void cancel() throw() {
+				mNext.store(mKind == parallel_for_schedule::SCHEDULE_STATIC ? mValue : mCount, std::memory_order_relaxed);
+			}
+		};
+
+		/*!
+			\brief Executes chunks of a parallel loop until none are left.
+			\detail Pause requests are only checked between chunks.
+			\tparam C The chunk function, called with the first and one past the last iteration of a chunk, and the index of the task.
+		*/
+		template<class C>
+		class parallel_for_chunk_task : public task<void> {
+		private:
+			parallel_for_claim& mClaim;		//!< Owned by the thread that started the loop, which waits for every task to complete.
+			const C& mChunk;				//!< Owned by the thread that started the loop.
+			const size_t mIndex;			//!< Identifies this task among the ones executing the loop, the calling thread is 0.
+		public:
+			parallel_for_chunk_task(parallel_for_claim& aClaim, const C& aChunk, size_t aIndex) :
+				mClaim(aClaim),
+				mChunk(aChunk),
+				mIndex(aIndex)
+			{}
+
+			void on_execute(as::task_controller& aController) override {
+				on_resume(aController, 0);
+			}
+
+			void on_resume(as::task_controller& aController, uint8_t aLocation) override {
+				size_t begin, end;
+				try {
+					for(;;) {
+#ifndef ASMITH_DISABLE_PARALLEL_FOR_PAUSE
+						if(is_pause_requested() && pause(aController, aLocation)) return;
+#endif
+						if(! mClaim.claim(begin, end)) break;
+						mChunk(begin, end, mIndex);
+					}
+				}catch(...) {
+					mClaim.cancel();
+					throw;
+				}
+				set_return();
+			}
+		};
+
+		/*!
+			\brief Execute a loop of aCount iterations in parallel.
+			\detail The calling thread claims chunks alongside the scheduled tasks, then helps execute other tasks until they complete.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aCount The number of iterations.
+			\param aPlan How iterations are divided between threads.
+			\param aPriority The priority to schedule the tasks with.
+			\param aChunk Called with the first and one past the last iteration of each chunk,
+			and the index of the thread executing it in the range [0, aPlan.mThreads).
+		*/
+		template<class C>
+		void parallel_for_chunks(task_dispatcher& aDispatcher, size_t aCount, const parallel_for_plan& aPlan, task_dispatcher::priority aPriority, const C& aChunk) {
+			if(aCount == 0) return;
+
+			const size_t threads = aPlan.mThreads;
+			parallel_for_claim claim(aCount, aPlan);
+
+			typedef parallel_for_chunk_task<C> chunk_task;
+			std::vector<task_handle<void>, slab_allocator<task_handle<void>>> handles(threads);
+			std::vector<task_dispatcher::task_ptr, slab_allocator<task_dispatcher::task_ptr>> tasks(threads - 1);
+			for(size_t i = 1; i < threads; ++i) {
+				const std::shared_ptr<chunk_task> task = make_task<chunk_task>(claim, aChunk, i);
+				handles[i] = task_handle<void>(task);
+				tasks[i - 1] = task;
+			}
+			aDispatcher.schedule_bulk(tasks, aPriority);
+
+			// The calling thread claims chunks itself instead of sitting idle
+			std::exception_ptr exception;
+			try {
+				size_t begin, end;
+				while(claim.claim(begin, end)) aChunk(begin, end, 0);
+			}catch(...) {
+				claim.cancel();
+				exception = std::current_exception();
+			}
+
+			// Every task must finish before returning, even if one threw, because they reference this stack frame
+			for(size_t i = 1; i < threads; ++i) aDispatcher.wait(handles[i]);
+			if(exception) std::rethrow_exception(exception);
+			for(size_t i = 1; i < threads; ++i) handles[i].get();
+		}
+
+		/*!
+			\brief Execute a loop of aCount iterations in parallel.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aCount The number of iterations.
+			\param aSchedule How iterations are divided between threads.
+			\param aPriority The priority to schedule the tasks with.
+			\param aChunk Called with the first and one past the last iteration of each chunk.
+		*/
+		template<class C>
+		void parallel_for_chunks(task_dispatcher& aDispatcher, size_t aCount, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority, const C& aChunk) {
+			parallel_for_chunks(aDispatcher, aCount, parallel_for_plan(aCount, aSchedule), aPriority, [&](size_t aBegin, size_t aEnd, size_t)->void {
+				aChunk(aBegin, aEnd);
+			});
+		}
+
+		template<class I, class F>
+		void parallel_for_range(task_dispatcher& aDispatcher, I aBegin, I aEnd, const F& aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority, std::integral_constant<int, 0>) {
+			// Integral index
+			parallel_for_chunks(
+				aDispatcher,
+				aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0,
+				aSchedule,
+				aPriority,
+				[&](size_t aChunkBegin, size_t aChunkEnd)->void {
+					aFunction(static_cast<I>(aBegin + static_cast<I>(aChunkBegin)), static_cast<I>(aBegin + static_cast<I>(aChunkEnd)));
 				}
-				for(size_t i = 0; i < aBlocks; ++i) futures[i].get();
-			}catch (std::exception& e) {
-				delete[] futures;
-				throw e;
+			);
+		}
+
+		template<class T, class F>
+		void parallel_for_range(task_dispatcher& aDispatcher, T* aBegin, T* aEnd, const F& aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority, std::integral_constant<int, 1>) {
+			// Contiguous array, chunks are made from whole cache lines so that two threads never write to the same line
+			const size_t count = aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+			const uintptr_t address = reinterpret_cast<uintptr_t>(aBegin);
+			const bool aligned = sizeof(T) <= CACHE_LINE_SIZE && CACHE_LINE_SIZE % sizeof(T) == 0 && address % sizeof(T) == 0;
+			const size_t line = aligned ? CACHE_LINE_SIZE / sizeof(T) : 1;
+			const size_t offset = aligned ? (address % CACHE_LINE_SIZE) / sizeof(T) : 0;
+
+			// Chunk sizes are given in elements, so they are rounded up to whole lines
+			const size_t lines = (aSchedule.get_value() + line - 1) / line;
+			switch(aSchedule.get_kind()) {
+			case parallel_for_schedule::SCHEDULE_DYNAMIC:
+				aSchedule = parallel_for_schedule::dynamic(lines);
+				break;
+			case parallel_for_schedule::SCHEDULE_GUIDED:
+				aSchedule = parallel_for_schedule::guided(lines);
+				break;
+			default:
+				break;
 			}
 
-			delete[] futures;
+			parallel_for_chunks(
+				aDispatcher,
+				count == 0 ? 0 : (offset + count + line - 1) / line,
+				aSchedule,
+				aPriority,
+				[&](size_t aChunkBegin, size_t aChunkEnd)->void {
+					const size_t begin = aChunkBegin * line < offset ? 0 : aChunkBegin * line - offset;
+					const size_t end = std::min(aChunkEnd * line - offset, count);
+					aFunction(aBegin + begin, aBegin + end);
+				}
+			);
+		}
+
+		template<class I, class F>
+		void parallel_for_range(task_dispatcher& aDispatcher, I aBegin, I aEnd, const F& aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority, std::integral_constant<int, 2>) {
+			// Random access iterator
+			const typename std::iterator_traits<I>::difference_type count = std::distance(aBegin, aEnd);
+			parallel_for_chunks(
+				aDispatcher,
+				count > 0 ? static_cast<size_t>(count) : 0,
+				aSchedule,
+				aPriority,
+				[&](size_t aChunkBegin, size_t aChunkEnd)->void {
+					aFunction(std::next(aBegin, aChunkBegin), std::next(aBegin, aChunkEnd));
+				}
+			);
 		}
 	}
 
+	/*!
+		\brief Execute a loop in parallel, passing whole chunks of the range to the loop body.
+		\detail The body is called as aFunction(chunk_begin, chunk_end) and should loop over [chunk_begin, chunk_end) itself,
+		which keeps the inner loop simple enough for the compiler to vectorise. Pause requests are only checked between chunks.
+		When I is a pointer and the element size divides the cache line size, the chunk edges fall on cache line boundaries and
+		chunk sizes are rounded up to whole lines. Otherwise, and for other types of I, chunks are split at any element.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first index, pointer or random access iterator.
+		\param aEnd One past the last index, pointer or random access iterator.
+		\param aFunction The loop body.
+		\param aSchedule How iterations are divided between threads.
+		\param aPriority The priority to schedule the tasks with.
+	*/
 	template<class I, class F>
-	void parallel_for_less_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
-		implementation::parallel_for<I, F>(
+	void parallel_for_range(task_dispatcher& aDispatcher, I aBegin, I aEnd, F aFunction, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		implementation::parallel_for_range(aDispatcher, aBegin, aEnd, aFunction, aSchedule, aPriority, std::integral_constant<int, std::is_integral<I>::value ? 0 : std::is_pointer<I>::value ? 1 : 2>());
+	}
+
+	template<class I, class F>
+	void parallel_for_less_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const F& function = aFunction;
+		implementation::parallel_for_chunks(
 			aDispatcher,
-			aMin,
-			aMax,
-			aFunction,
-			aBlocks,
+			aMin < aMax ? static_cast<size_t>(aMax - aMin) : 0,
+			aSchedule,
 			aPriority,
-			[=](I i)->I {
-				const I range = aMax - aMin;
-				const I sub_range = range / aBlocks;
-				return aMin + (sub_range * i);
-			},
-			[=](I i)->I {
-				const I range = aMax - aMin;
-				const I sub_range = range / aBlocks;
-				return i + 1 == aBlocks ? aMax : sub_range * (i + 1);
-			},
-			[](const I a, const I b)->bool{ return a < b; },
-			[](I& i)->void { ++i; }
+			[&](size_t aBegin, size_t aEnd)->void {
+				for(size_t i = aBegin; i < aEnd; ++i) function(static_cast<I>(aMin + static_cast<I>(i)));
+			}
 		);
 	}
 
 	template<class I, class F>
-	void parallel_for_less_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
-		implementation::parallel_for<I, F>(
+	void parallel_for_less_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const F& function = aFunction;
+		implementation::parallel_for_chunks(
 			aDispatcher,
-			aMin,
-			aMax,
-			aFunction,
-			aBlocks,
+			aMin <= aMax ? static_cast<size_t>(aMax - aMin) + 1 : 0,
+			aSchedule,
 			aPriority,
-			[=](I i)->I {
-				const I range = aMax - aMin;
-				const I sub_range = range / aBlocks;
-				return i == 0 ? aMin : aMin + (sub_range * i) + 1;
-			},
-			[=](int i)->I {
-				const I range = aMax - aMin;
-				const I sub_range = range / aBlocks;
-				return i + 1 == aBlocks ? aMax : sub_range * (i + 1);
-			},
-			[](const I a, const I b)->bool{ return a <= b; },
-			[](I& i)->void { ++i; }
+			[&](size_t aBegin, size_t aEnd)->void {
+				for(size_t i = aBegin; i < aEnd; ++i) function(static_cast<I>(aMin + static_cast<I>(i)));
+			}
 		);
 	}
 
 	template<class I, class F>
-	void parallel_for_greater_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
-		implementation::parallel_for<I, F>(
+	void parallel_for_greater_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const F& function = aFunction;
+		implementation::parallel_for_chunks(
 			aDispatcher,
-			aMin,
-			aMax,
-			aFunction,
-			aBlocks,
+			aMin > aMax ? static_cast<size_t>(aMin - aMax) : 0,
+			aSchedule,
 			aPriority,
-			[=](I i)->I {
-				const I range = aMin - aMax;
-				const I sub_range = range / aBlocks;
-				return aMin -(sub_range * i);
-			},
-			[=](I i)->I {
-				const I range = aMin - aMax;
-				const I sub_range = range / aBlocks;
-				return i + 1 == aBlocks ? aMax : aMin - (sub_range * (i + 1));
-			},
-			[](const I a, const I b)->bool{ return a > b; },
-			[](I& i)->void { --i; }
+			[&](size_t aBegin, size_t aEnd)->void {
+				for(size_t i = aBegin; i < aEnd; ++i) function(static_cast<I>(aMin - static_cast<I>(i)));
+			}
 		);
 	}
 
 	template<class I, class F>
-	void parallel_for_greater_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
-		implementation::parallel_for<I, F>(
+	void parallel_for_greater_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const F& function = aFunction;
+		implementation::parallel_for_chunks(
 			aDispatcher,
-			aMin,
-			aMax,
-			aFunction,
-			aBlocks,
+			aMin >= aMax ? static_cast<size_t>(aMin - aMax) + 1 : 0,
+			aSchedule,
 			aPriority,
-			[=](I i)->I {
-				const I range = aMin - aMax;
-				const I sub_range = range / aBlocks;
-				return i == 0 ? aMin : aMin - (sub_range * i) - 1;
-			},
-			[=](I i)->I {
-				const I range = aMin - aMax;
-				const I sub_range = range / aBlocks;
-				return i + 1 == aBlocks ? aMax : aMin - (sub_range * (i + 1));
-			},
-			[](const I a, const I b)->bool{ return a >= b; },
-			[](I& i)->void { --i; }
+			[&](size_t aBegin, size_t aEnd)->void {
+				for(size_t i = aBegin; i < aEnd; ++i) function(static_cast<I>(aMin - static_cast<I>(i)));
+			}
 		);
 	}
+
+	template<class I, class F>
+	void parallel_for_less_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		parallel_for_less_than<I, F>(aDispatcher, aMin, aMax, aFunction, parallel_for_schedule::static_blocks(aBlocks), aPriority);
+	}
+
+	template<class I, class F>
+	void parallel_for_less_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		parallel_for_less_than_equals<I, F>(aDispatcher, aMin, aMax, aFunction, parallel_for_schedule::static_blocks(aBlocks), aPriority);
+	}
+
+	template<class I, class F>
+	void parallel_for_greater_than(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		parallel_for_greater_than<I, F>(aDispatcher, aMin, aMax, aFunction, parallel_for_schedule::static_blocks(aBlocks), aPriority);
+	}
+
+	template<class I, class F>
+	void parallel_for_greater_than_equals(task_dispatcher& aDispatcher, I aMin, I aMax, F aFunction, uint8_t aBlocks = 4, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		parallel_for_greater_than_equals<I, F>(aDispatcher, aMin, aMax, aFunction, parallel_for_schedule::static_blocks(aBlocks), aPriority);
+	}
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,286 @@
+#ifndef ASMITH_PARALLEL_FOR_TILED_HPP
+#define ASMITH_PARALLEL_FOR_TILED_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cmath>
+#include <cstdint>
+#include "parallel_for.hpp"
+
+namespace as {
+	namespace implementation {
+		enum : size_t {
+			TILE_L1_BYTES = 32 * 1024,		//!< The data that an automatic tile is sized to when it should fit in L1.
+			TILE_L2_BYTES = 256 * 1024,		//!< The data that an automatic tile is sized to when it should fit in L2.
+			TILES_PER_THREAD = 4			//!< Automatic tiles are shrunk until there are at least this many for each hardware thread.
+		};
+	}
+
+	/*!
+		\brief Describes the size of the tiles that a multi-dimensional loop is divided into.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class tile_shape {
+	private:
+		size_t mSize[3];		//!< The number of iterations along each dimension, or 0 to size the tile automatically.
+		size_t mElementSize;	//!< The number of bytes touched by each iteration (automatic tiles only).
+		size_t mCacheBytes;		//!< The number of bytes that a tile should fit in (automatic tiles only).
+
+		tile_shape(size_t aX, size_t aY, size_t aZ, size_t aElementSize, size_t aCacheBytes) :
+			mElementSize(aElementSize),
+			mCacheBytes(aCacheBytes)
+		{
+			mSize[0] = aX;
+			mSize[1] = aY;
+			mSize[2] = aZ;
+		}
+	public:
+		/*!
+			\brief Use tiles of a fixed size.
+			\param aX The number of iterations along the first (innermost) dimension.
+			\param aY The number of iterations along the second dimension.
+			\param aZ The number of iterations along the third dimension.
+		*/
+		static tile_shape fixed(size_t aX, size_t aY, size_t aZ = 1) {
+			return tile_shape(std::max<size_t>(aX, 1), std::max<size_t>(aY, 1), std::max<size_t>(aZ, 1), 0, 0);
+		}
+
+		/*!
+			\brief Size tiles so that the data they touch fits in a cache.
+			\detail Tiles are close to square, with the innermost dimension rounded up to whole cache lines, and are shrunk if
+			there would be too few of them to keep every hardware thread busy.
+			\param aElementSize The number of bytes touched by each iteration.
+			\param aCacheBytes The number of bytes that a tile should fit in.
+		*/
+		static tile_shape automatic(size_t aElementSize = sizeof(float), size_t aCacheBytes = implementation::TILE_L1_BYTES) {
+			return tile_shape(0, 0, 0, std::max<size_t>(aElementSize, 1), std::max<size_t>(aCacheBytes, 1));
+		}
+
+		/*!
+			\brief Return the size of the tiles for a range.
+			\param aExtent The number of iterations along each dimension.
+			\param aDimensions The number of dimensions, 2 or 3.
+			\param aSize Receives the number of iterations in a tile along each dimension, never more than aExtent.
+		*/
+		void get_size(const size_t* aExtent, size_t aDimensions, size_t* aSize) const {
+			for(size_t i = 0; i < 3; ++i) aSize[i] = 1;
+			if(mSize[0] != 0) {
+				for(size_t i = 0; i < aDimensions; ++i) aSize[i] = std::min(mSize[i], std::max<size_t>(aExtent[i], 1));
+				return;
+			}
+
+			// Start from a square or cubic tile, with the innermost dimension a whole number of cache lines
+			const size_t elements = std::max<size_t>(mCacheBytes / mElementSize, 1);
+			const size_t line = std::max<size_t>(implementation::CACHE_LINE_SIZE / mElementSize, 1);
+			const double side = aDimensions == 3 ? std::cbrt(static_cast<double>(elements)) : std::sqrt(static_cast<double>(elements));
+			size_t remaining = elements;
+			for(size_t i = 0; i < aDimensions; ++i) {
+				size_t tmp = i + 1 == aDimensions ? remaining : static_cast<size_t>(side);
+				if(i == 0) tmp = ((std::max<size_t>(tmp, 1) + line - 1) / line) * line;
+				aSize[i] = std::max<size_t>(std::min(tmp, std::max<size_t>(aExtent[i], 1)), 1);
+				remaining = std::max<size_t>(remaining / aSize[i], 1);
+			}
+
+			// Split the outermost dimensions first so that rows stay contiguous
+			const size_t target = std::max<size_t>(std::thread::hardware_concurrency(), 1) * implementation::TILES_PER_THREAD;
+			for(;;) {
+				size_t tiles = 1;
+				for(size_t i = 0; i < aDimensions; ++i) tiles *= (std::max<size_t>(aExtent[i], 1) + aSize[i] - 1) / aSize[i];
+				if(tiles >= target) break;
+
+				size_t largest = aDimensions;
+				for(size_t i = aDimensions; i > 0; --i) if(aSize[i - 1] > 1 && (largest == aDimensions || aSize[i - 1] > aSize[largest])) largest = i - 1;
+				if(largest == aDimensions) break;
+				aSize[largest] = (aSize[largest] + 1) / 2;
+			}
+		}
+	};
+
+	namespace implementation {
+		/*!
+			\brief Spread the low 32 bits of a value out so that there is a zero bit between each of them.
+		*/
+		inline uint64_t morton_spread_2(uint64_t aValue) throw() {
+			aValue &= 0xFFFFFFFFull;
+			aValue = (aValue | (aValue << 16)) & 0x0000FFFF0000FFFFull;
+			aValue = (aValue | (aValue << 8)) & 0x00FF00FF00FF00FFull;
+			aValue = (aValue | (aValue << 4)) & 0x0F0F0F0F0F0F0F0Full;
+			aValue = (aValue | (aValue << 2)) & 0x3333333333333333ull;
+			aValue = (aValue | (aValue << 1)) & 0x5555555555555555ull;
+			return aValue;
+		}
+
+		/*!
+			\brief Reverse morton_spread_2.
+		*/
+		inline uint64_t morton_compact_2(uint64_t aValue) throw() {
+			aValue &= 0x5555555555555555ull;
+			aValue = (aValue | (aValue >> 1)) & 0x3333333333333333ull;
+			aValue = (aValue | (aValue >> 2)) & 0x0F0F0F0F0F0F0F0Full;
+			aValue = (aValue | (aValue >> 4)) & 0x00FF00FF00FF00FFull;
+			aValue = (aValue | (aValue >> 8)) & 0x0000FFFF0000FFFFull;
+			aValue = (aValue | (aValue >> 16)) & 0x00000000FFFFFFFFull;
+			return aValue;
+		}
+
+		/*!
+			\brief Spread the low 21 bits of a value out so that there are two zero bits between each of them.
+		*/
+		inline uint64_t morton_spread_3(uint64_t aValue) throw() {
+			aValue &= 0x1FFFFFull;
+			aValue = (aValue | (aValue << 32)) & 0x001F00000000FFFFull;
+			aValue = (aValue | (aValue << 16)) & 0x001F0000FF0000FFull;
+			aValue = (aValue | (aValue << 8)) & 0x100F00F00F00F00Full;
+			aValue = (aValue | (aValue << 4)) & 0x10C30C30C30C30C3ull;
+			aValue = (aValue | (aValue << 2)) & 0x1249249249249249ull;
+			return aValue;
+		}
+
+		/*!
+			\brief Reverse morton_spread_3.
+		*/
+		inline uint64_t morton_compact_3(uint64_t aValue) throw() {
+			aValue &= 0x1249249249249249ull;
+			aValue = (aValue | (aValue >> 2)) & 0x10C30C30C30C30C3ull;
+			aValue = (aValue | (aValue >> 4)) & 0x100F00F00F00F00Full;
+			aValue = (aValue | (aValue >> 8)) & 0x001F0000FF0000FFull;
+			aValue = (aValue | (aValue >> 16)) & 0x001F00000000FFFFull;
+			aValue = (aValue | (aValue >> 32)) & 0x00000000001FFFFFull;
+			return aValue;
+		}
+
+		/*!
+			\brief Execute a 2 or 3 dimensional loop in parallel, one tile at a time.
+			\detail The tiles are sorted by their Morton (Z-order) code, so tiles that are claimed one after another are close
+			together in every dimension. If the tile grid is too large for a Morton code the tiles are visited in row order.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aBegin The first iteration along each dimension.
+			\param aEnd One past the last iteration along each dimension.
+			\param aDimensions The number of dimensions, 2 or 3.
+			\param aTile The size of the tiles.
+			\param aSchedule How tiles are divided between threads.
+			\param aPriority The priority to schedule the tasks with.
+			\param aTileFunction Called with the first and one past the last iteration of a tile along each dimension.
+		*/
+		template<class C>
+		void parallel_for_tiles(task_dispatcher& aDispatcher, const size_t* aBegin, const size_t* aEnd, size_t aDimensions, const tile_shape& aTile, parallel_for_schedule aSchedule, task_dispatcher::priority aPriority, const C& aTileFunction) {
+			size_t extent[3] = { 1, 1, 1 };
+			for(size_t i = 0; i < aDimensions; ++i) {
+				if(aEnd[i] <= aBegin[i]) return;
+				extent[i] = aEnd[i] - aBegin[i];
+			}
+
+			size_t size[3];
+			aTile.get_size(extent, aDimensions, size);
+			size_t grid[3];
+			size_t count = 1;
+			for(size_t i = 0; i < 3; ++i) {
+				grid[i] = (extent[i] + size[i] - 1) / size[i];
+				count *= grid[i];
+			}
+
+			// Morton codes cover 32 bits of each dimension in 2D and 21 bits in 3D
+			const uint64_t limit = aDimensions == 3 ? (1ull << 21) : (1ull << 32);
+			const bool morton = grid[0] <= limit && grid[1] <= limit && grid[2] <= limit;
+			std::vector<uint64_t, slab_allocator<uint64_t>> order;
+			if(morton) {
+				order.reserve(count);
+				for(size_t z = 0; z < grid[2]; ++z) for(size_t y = 0; y < grid[1]; ++y) for(size_t x = 0; x < grid[0]; ++x) {
+					order.push_back(aDimensions == 3 ?
+						morton_spread_3(x) | (morton_spread_3(y) << 1) | (morton_spread_3(z) << 2) :
+						morton_spread_2(x) | (morton_spread_2(y) << 1)
+					);
+				}
+				std::sort(order.begin(), order.end());
+			}
+
+			parallel_for_chunks(aDispatcher, count, aSchedule, aPriority, [&](size_t aChunkBegin, size_t aChunkEnd)->void {
+				size_t tile[3];
+				size_t begin[3];
+				size_t end[3];
+				for(size_t i = aChunkBegin; i < aChunkEnd; ++i) {
+					if(! morton) {
+						tile[0] = i % grid[0];
+						tile[1] = (i / grid[0]) % grid[1];
+						tile[2] = i / (grid[0] * grid[1]);
+					}else if(aDimensions == 3) {
+						tile[0] = static_cast<size_t>(morton_compact_3(order[i]));
+						tile[1] = static_cast<size_t>(morton_compact_3(order[i] >> 1));
+						tile[2] = static_cast<size_t>(morton_compact_3(order[i] >> 2));
+					}else {
+						tile[0] = static_cast<size_t>(morton_compact_2(order[i]));
+						tile[1] = static_cast<size_t>(morton_compact_2(order[i] >> 1));
+						tile[2] = 0;
+					}
+					for(size_t j = 0; j < 3; ++j) {
+						begin[j] = aBegin[j] + tile[j] * size[j];
+						end[j] = std::min(begin[j] + size[j], aBegin[j] + extent[j]);
+					}
+					aTileFunction(begin, end);
+				}
+			});
+		}
+	}
+
+	/*!
+		\brief Execute a 2 dimensional loop in parallel, divided into cache sized tiles.
+		\detail Unlike nesting parallel_for_less_than over rows, each task works on a compact tile and there is one unit of
+		parallelism per tile. Tiles are claimed in Morton (Z-order) so that consecutive tiles share cache lines.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aXBegin The first iteration of the inner dimension.
+		\param aXEnd One past the last iteration of the inner dimension.
+		\param aYBegin The first iteration of the outer dimension.
+		\param aYEnd One past the last iteration of the outer dimension.
+		\param aFunction Called with the bounds of each tile as (x begin, x end, y begin, y end).
+		\param aTile The size of the tiles.
+		\param aSchedule How tiles are divided between threads.
+		\param aPriority The priority to schedule the tasks with.
+	*/
+	template<class F>
+	void parallel_for_2d(task_dispatcher& aDispatcher, size_t aXBegin, size_t aXEnd, size_t aYBegin, size_t aYEnd, F aFunction, tile_shape aTile = tile_shape::automatic(), parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const size_t begin[3] = { aXBegin, aYBegin, 0 };
+		const size_t end[3] = { aXEnd, aYEnd, 1 };
+		implementation::parallel_for_tiles(aDispatcher, begin, end, 2, aTile, aSchedule, aPriority, [&aFunction](const size_t* aTileBegin, const size_t* aTileEnd)->void {
+			aFunction(aTileBegin[0], aTileEnd[0], aTileBegin[1], aTileEnd[1]);
+		});
+	}
+
+	/*!
+		\brief Execute a 3 dimensional loop in parallel, divided into cache sized tiles.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aXBegin The first iteration of the inner dimension.
+		\param aXEnd One past the last iteration of the inner dimension.
+		\param aYBegin The first iteration of the middle dimension.
+		\param aYEnd One past the last iteration of the middle dimension.
+		\param aZBegin The first iteration of the outer dimension.
+		\param aZEnd One past the last iteration of the outer dimension.
+		\param aFunction Called with the bounds of each tile as (x begin, x end, y begin, y end, z begin, z end).
+		\param aTile The size of the tiles.
+		\param aSchedule How tiles are divided between threads.
+		\param aPriority The priority to schedule the tasks with.
+		\see parallel_for_2d
+	*/
+	template<class F>
+	void parallel_for_3d(task_dispatcher& aDispatcher, size_t aXBegin, size_t aXEnd, size_t aYBegin, size_t aYEnd, size_t aZBegin, size_t aZEnd, F aFunction, tile_shape aTile = tile_shape::automatic(), parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		const size_t begin[3] = { aXBegin, aYBegin, aZBegin };
+		const size_t end[3] = { aXEnd, aYEnd, aZEnd };
+		implementation::parallel_for_tiles(aDispatcher, begin, end, 3, aTile, aSchedule, aPriority, [&aFunction](const size_t* aTileBegin, const size_t* aTileEnd)->void {
+			aFunction(aTileBegin[0], aTileEnd[0], aTileBegin[1], aTileEnd[1], aTileBegin[2], aTileEnd[2]);
+		});
+	}
+}
+
+#endif
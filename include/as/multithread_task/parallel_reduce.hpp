@@ -0,0 +1,201 @@
+#ifndef ASMITH_PARALLEL_REDUCE_HPP
+#define ASMITH_PARALLEL_REDUCE_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "parallel_for.hpp"
+
+namespace as {
+	namespace implementation {
+
+		/*!
+			\brief An accumulator that occupies whole cache lines, so that threads updating neighbouring accumulators do not contend.
+		*/
+		template<class T>
+		struct alignas(CACHE_LINE_SIZE) padded_accumulator {
+			T mValue;
+
+			padded_accumulator(const T& aValue) :
+				mValue(aValue)
+			{}
+		};
+
+		/*!
+			\brief The partial result of a run of consecutive chunks that were claimed by the same thread.
+		*/
+		template<class T>
+		struct reduce_run {
+			size_t mBegin;	//!< The first iteration of the run.
+			size_t mEnd;	//!< One past the last iteration of the run.
+			T mValue;		//!< The combined value of the iterations in the run.
+		};
+
+		/*!
+			\brief The runs of one thread, in the order that the thread claimed them.
+		*/
+		template<class T>
+		struct alignas(CACHE_LINE_SIZE) reduce_runs {
+			std::vector<reduce_run<T>, slab_allocator<reduce_run<T>>> mRuns;
+		};
+
+		struct identity_transform {
+			template<class V>
+			V&& operator()(V&& aValue) const throw() {
+				return std::forward<V>(aValue);
+			}
+		};
+
+		template<class I>
+		size_t reduce_count(I aBegin, I aEnd, std::true_type) throw() {
+			return aBegin < aEnd ? static_cast<size_t>(aEnd - aBegin) : 0;
+		}
+
+		template<class I>
+		size_t reduce_count(I aBegin, I aEnd, std::false_type) {
+			const typename std::iterator_traits<I>::difference_type count = std::distance(aBegin, aEnd);
+			return count > 0 ? static_cast<size_t>(count) : 0;
+		}
+
+		template<class I, class T, class R, class X>
+		void reduce_chunk(I aBegin, size_t aChunkBegin, size_t aChunkEnd, T& aAccumulator, const R& aReduce, const X& aTransform, std::true_type) {
+			// Integral range, the elements are the indices themselves
+			for(size_t i = aChunkBegin; i < aChunkEnd; ++i) aAccumulator = aReduce(aAccumulator, aTransform(static_cast<I>(aBegin + static_cast<I>(i))));
+		}
+
+		template<class I, class T, class R, class X>
+		void reduce_chunk(I aBegin, size_t aChunkBegin, size_t aChunkEnd, T& aAccumulator, const R& aReduce, const X& aTransform, std::false_type) {
+			// Iterator range
+			I it = std::next(aBegin, aChunkBegin);
+			for(size_t i = aChunkBegin; i < aChunkEnd; ++i, ++it) aAccumulator = aReduce(aAccumulator, aTransform(*it));
+		}
+	}
+
+	/*!
+		\brief Transform each element of a range and combine the results in parallel.
+		\detail Each thread accumulates consecutive chunks into its own partial result, starting a new partial result whenever the
+		chunk it claims does not follow on from its last one. The partial results are then put in the order of the range and
+		combined pairwise in a tree, so aReduce must be associative but need not be commutative. aIdentity must be its identity value.
+		In deterministic mode the range is instead split into fixed chunks, each with its own cache line padded partial result, and
+		the tree always combines them in the same order, so the result is reproducible even for operations that are not exactly
+		associative, such as floating point addition.
+		Use SCHEDULE_STATIC or SCHEDULE_DYNAMIC for chunks that do not depend on the hardware concurrency.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first index, pointer or random access iterator.
+		\param aEnd One past the last index, pointer or random access iterator.
+		\param aIdentity The identity value of aReduce.
+		\param aReduce Combines two values, called as aReduce(T, T).
+		\param aTransform Called on each element (or each index for an integral range) before it is combined.
+		\param aSchedule How iterations are divided between threads.
+		\param aDeterministic True if the partial results must always be combined in the same order.
+		\param aPriority The priority to schedule the tasks with.
+		\return The combined value.
+	*/
+	template<class I, class T, class R, class X>
+	T parallel_transform_reduce(task_dispatcher& aDispatcher, I aBegin, I aEnd, T aIdentity, R aReduce, X aTransform, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), bool aDeterministic = false, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		typedef implementation::padded_accumulator<T> accumulator;
+		typedef typename std::is_integral<I>::type integral;
+
+		const size_t count = implementation::reduce_count(aBegin, aEnd, integral());
+		if(count == 0) return aIdentity;
+
+		// In deterministic mode the chunks are fixed so that they can be combined in the same order every time
+		size_t chunk = 0;
+		if(aDeterministic) {
+			switch(aSchedule.get_kind()) {
+			case parallel_for_schedule::SCHEDULE_STATIC:
+				chunk = (count + std::max<size_t>(aSchedule.get_value(), 1) - 1) / std::max<size_t>(aSchedule.get_value(), 1);
+				break;
+			case parallel_for_schedule::SCHEDULE_DYNAMIC:
+				chunk = std::max<size_t>(aSchedule.get_value(), 1);
+				break;
+			default:
+				chunk = std::max<size_t>(count / (std::max<size_t>(std::thread::hardware_concurrency(), 1) * 4), 1);
+				break;
+			}
+			aSchedule = parallel_for_schedule::dynamic(chunk);
+		}
+
+		const implementation::parallel_for_plan plan(count, aSchedule);
+		const R& reduce = aReduce;
+		const X& transform = aTransform;
+
+		if(! aDeterministic) {
+			typedef implementation::reduce_run<T> run;
+			std::vector<implementation::reduce_runs<T>, slab_allocator<implementation::reduce_runs<T>>> threads(plan.mThreads);
+			implementation::parallel_for_chunks(aDispatcher, count, plan, aPriority, [&](size_t aChunkBegin, size_t aChunkEnd, size_t aThread)->void {
+				std::vector<run, slab_allocator<run>>& runs = threads[aThread].mRuns;
+				if(runs.empty() || runs.back().mEnd != aChunkBegin) runs.push_back(run{ aChunkBegin, aChunkBegin, aIdentity });
+				run& current = runs.back();
+
+				// Accumulate into a local so that the hot loop does not write through to the shared array
+				T tmp = std::move(current.mValue);
+				implementation::reduce_chunk(aBegin, aChunkBegin, aChunkEnd, tmp, reduce, transform, integral());
+				current.mValue = std::move(tmp);
+				current.mEnd = aChunkEnd;
+			});
+
+			// Runs from different threads interleave, so they are put back in the order of the range before being combined
+			std::vector<run*, slab_allocator<run*>> ordered;
+			for(implementation::reduce_runs<T>& i : threads) for(run& j : i.mRuns) ordered.push_back(&j);
+			std::sort(ordered.begin(), ordered.end(), [](const run* aFirst, const run* aSecond)->bool {
+				return aFirst->mBegin < aSecond->mBegin;
+			});
+			const size_t run_count = ordered.size();
+			for(size_t step = 1; step < run_count; step *= 2) {
+				for(size_t i = 0; i + step < run_count; i += step * 2) {
+					ordered[i]->mValue = reduce(ordered[i]->mValue, ordered[i + step]->mValue);
+				}
+			}
+			return ordered[0]->mValue;
+		}
+
+		// In deterministic mode each chunk has its own partial result
+		const size_t partial_count = (count + chunk - 1) / chunk;
+		std::vector<accumulator, slab_allocator<accumulator>> partials(partial_count, accumulator(aIdentity));
+		implementation::parallel_for_chunks(aDispatcher, count, plan, aPriority, [&](size_t aChunkBegin, size_t aChunkEnd, size_t)->void {
+			T& partial = partials[aChunkBegin / chunk].mValue;
+			T tmp = std::move(partial);
+			implementation::reduce_chunk(aBegin, aChunkBegin, aChunkEnd, tmp, reduce, transform, integral());
+			partial = std::move(tmp);
+		});
+
+		for(size_t step = 1; step < partial_count; step *= 2) {
+			for(size_t i = 0; i + step < partial_count; i += step * 2) {
+				partials[i].mValue = reduce(partials[i].mValue, partials[i + step].mValue);
+			}
+		}
+		return partials[0].mValue;
+	}
+
+	/*!
+		\brief Combine the elements of a range in parallel.
+		\detail See parallel_transform_reduce.
+		\param aDispatcher The dispatcher to schedule tasks with.
+		\param aBegin The first index, pointer or random access iterator.
+		\param aEnd One past the last index, pointer or random access iterator.
+		\param aIdentity The identity value of aReduce.
+		\param aReduce Combines two values, called as aReduce(T, T).
+		\param aSchedule How iterations are divided between threads.
+		\param aDeterministic True if the partial results must always be combined in the same order.
+		\param aPriority The priority to schedule the tasks with.
+		\return The combined value.
+	*/
+	template<class I, class T, class R>
+	T parallel_reduce(task_dispatcher& aDispatcher, I aBegin, I aEnd, T aIdentity, R aReduce, parallel_for_schedule aSchedule = parallel_for_schedule::automatic(), bool aDeterministic = false, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM) {
+		return parallel_transform_reduce(aDispatcher, aBegin, aEnd, aIdentity, aReduce, implementation::identity_transform(), aSchedule, aDeterministic, aPriority);
+	}
+}
+
+#endif
@@ -0,0 +1,316 @@
+#ifndef ASMITH_PIPELINE_HPP
+#define ASMITH_PIPELINE_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "task_dispatcher.hpp"
+
+namespace as {
+	class pipeline;
+
+	namespace implementation {
+		enum pipeline_mode : uint8_t {
+			PIPELINE_SERIAL_IN_ORDER,		//!< One item at a time, in the order that the source produced them.
+			PIPELINE_SERIAL_OUT_OF_ORDER,	//!< One item at a time, in any order.
+			PIPELINE_PARALLEL				//!< Any number of items at once.
+		};
+
+		/*!
+			\brief A stage of a pipeline with the type of its items erased.
+			\detail Each stage keeps one output slot per token, the slot of a token holds the item that the stage produced for it
+			until the next stage has consumed it, so a pipeline never allocates while it is executing.
+		*/
+		class pipeline_stage {
+		public:
+			const pipeline_mode mMode;	//!< How items may pass through the stage.
+
+			pipeline_stage(pipeline_mode aMode) :
+				mMode(aMode)
+			{}
+
+			virtual ~pipeline_stage() {}
+
+			/*!
+				\brief Make sure that there is an output slot for every token.
+				\param aTokens The number of tokens.
+			*/
+			virtual void reserve(size_t) = 0;
+
+			/*!
+				\brief Process an item.
+				\param aPrevious The stage that produced the item, or nullptr for the source.
+				\param aToken The token that carries the item, the output is constructed in this slot.
+				\return False if the source has no more items.
+			*/
+			virtual bool execute(pipeline_stage*, size_t) = 0;
+
+			/*!
+				\brief Destroy the item in an output slot.
+				\param aToken The token that carries the item.
+			*/
+			virtual void destroy(size_t) throw() = 0;
+		};
+
+		template<class T>
+		class pipeline_output : public pipeline_stage {
+		private:
+			typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+			std::unique_ptr<storage[]> mSlots;	//!< One item for each token.
+			size_t mSize;						//!< The number of slots.
+		protected:
+			template<class... ARGS>
+			void construct(size_t aToken, ARGS&&... aArgs) {
+				new(&mSlots[aToken]) T(std::forward<ARGS>(aArgs)...);
+			}
+		public:
+			pipeline_output(pipeline_mode aMode) :
+				pipeline_stage(aMode),
+				mSize(0)
+			{}
+
+			T& get(size_t aToken) throw() {
+				return *reinterpret_cast<T*>(&mSlots[aToken]);
+			}
+
+			// Inherited from pipeline_stage
+
+			void reserve(size_t aTokens) override {
+				if(aTokens <= mSize) return;
+				mSlots.reset(new storage[aTokens]);
+				mSize = aTokens;
+			}
+
+			void destroy(size_t aToken) throw() override {
+				get(aToken).~T();
+			}
+		};
+
+		template<>
+		class pipeline_output<void> : public pipeline_stage {
+		protected:
+			void construct(size_t) throw() {}
+		public:
+			pipeline_output(pipeline_mode aMode) :
+				pipeline_stage(aMode)
+			{}
+
+			// Inherited from pipeline_stage
+
+			void reserve(size_t) override {}
+			void destroy(size_t) throw() override {}
+		};
+
+		template<class I, class O, class F>
+		class pipeline_filter : public pipeline_output<O> {
+		private:
+			F mFunction;
+		public:
+			pipeline_filter(pipeline_mode aMode, F&& aFunction) :
+				pipeline_output<O>(aMode),
+				mFunction(std::move(aFunction))
+			{}
+
+			// Inherited from pipeline_stage
+
+			bool execute(pipeline_stage* aPrevious, size_t aToken) override {
+				I& input = static_cast<pipeline_output<I>*>(aPrevious)->get(aToken);
+				if constexpr(std::is_void<O>::value) {
+					mFunction(std::move(input));
+				}else {
+					this->construct(aToken, mFunction(std::move(input)));
+				}
+				return true;
+			}
+		};
+	}
+
+	/*!
+		\brief Passes a stream of items through a sequence of stages.
+		\detail The source produces items one at a time, and each item is carried through the stages by a token. There is a fixed
+		number of tokens, so no more than that many items are in flight and memory use stays constant however long the stream is.
+		Each item is carried through as many stages as possible by the task that produced it. An item that has to wait for a
+		serial stage is parked with that stage, and when the stage becomes free a task is scheduled for the next parked item, so
+		idle workers pick up whichever stage has items ready.
+		If a stage throws, the source is stopped, the remaining items are discarded and the exception is rethrown by wait.
+		The pipeline cannot be modified while it is executing.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class pipeline {
+	public:
+		typedef implementation::pipeline_mode mode;
+
+		/*!
+			\brief Passed to the source so that it can end the stream.
+		*/
+		class flow_control {
+		private:
+			bool mStopped;
+		public:
+			flow_control() :
+				mStopped(false)
+			{}
+
+			/*!
+				\brief End the stream, the value returned by the current call is discarded.
+			*/
+			void stop() throw() {
+				mStopped = true;
+			}
+
+			bool is_stopped() const throw() {
+				return mStopped;
+			}
+		};
+
+		/*!
+			\brief Appends stages that take the output of the last stage.
+			\tparam T The type of item produced by the last stage.
+		*/
+		template<class T>
+		class chain {
+		private:
+			friend pipeline;
+
+			pipeline* mPipeline;
+
+			chain(pipeline& aPipeline) :
+				mPipeline(&aPipeline)
+			{}
+		public:
+			/*!
+				\brief Add a stage.
+				\param aMode PIPELINE_SERIAL_IN_ORDER, PIPELINE_SERIAL_OUT_OF_ORDER or PIPELINE_PARALLEL.
+				\param aFunction Called with each item as an rvalue, returns the item for the next stage or void.
+				\return The chain to add the next stage to.
+				\throw std::logic_error If the pipeline is executing.
+			*/
+			template<class F, class I = T>
+			chain<typename std::decay<typename std::invoke_result<F, I&&>::type>::type> then(mode aMode, F aFunction) {
+				typedef typename std::decay<typename std::invoke_result<F, I&&>::type>::type output;
+				mPipeline->add_stage(std::unique_ptr<implementation::pipeline_stage>(new implementation::pipeline_filter<I, output, F>(aMode, std::move(aFunction))));
+				return chain<output>(*mPipeline);
+			}
+		};
+	private:
+		struct state;
+
+		std::shared_ptr<state> mState;
+
+		void add_stage(std::unique_ptr<implementation::pipeline_stage>);
+
+		template<class T, class F>
+		class source_stage : public implementation::pipeline_output<T> {
+		private:
+			F mFunction;
+		public:
+			source_stage(F&& aFunction) :
+				implementation::pipeline_output<T>(implementation::PIPELINE_SERIAL_IN_ORDER),
+				mFunction(std::move(aFunction))
+			{}
+
+			// Inherited from pipeline_stage
+
+			bool execute(implementation::pipeline_stage*, size_t aToken) override {
+				flow_control control;
+				T tmp = mFunction(control);
+				if(control.is_stopped()) return false;
+				this->construct(aToken, std::move(tmp));
+				return true;
+			}
+		};
+	public:
+		/*!
+			\brief Create an empty pipeline.
+			\param aTokens The largest number of items that may be in flight at once.
+			\throw std::invalid_argument If aTokens is 0.
+		*/
+		pipeline(size_t aTokens);
+
+		/*!
+			\brief Destroy the pipeline, waiting for the current execution to complete.
+		*/
+		~pipeline();
+
+		pipeline(const pipeline&) = delete;
+		pipeline& operator=(const pipeline&) = delete;
+
+		/*!
+			\brief Set the first stage, which produces the items.
+			\detail The source is always serial, it is called until it calls flow_control::stop.
+			\param aFunction Called with a flow_control, returns the next item.
+			\return The chain to add the next stage to.
+			\throw std::logic_error If the pipeline is executing or already has a source.
+		*/
+		template<class F>
+		chain<typename std::decay<typename std::invoke_result<F, flow_control&>::type>::type> source(F aFunction) {
+			typedef typename std::decay<typename std::invoke_result<F, flow_control&>::type>::type output;
+			static_assert(! std::is_void<output>::value, "as::pipeline::source : The source must produce items");
+			if(get_stage_count() != 0) throw std::logic_error("as::pipeline::source : Pipeline already has a source");
+			add_stage(std::unique_ptr<implementation::pipeline_stage>(new source_stage<output, F>(std::move(aFunction))));
+			return chain<output>(*this);
+		}
+
+		/*!
+			\brief Return the number of stages, including the source.
+			\return The count.
+		*/
+		size_t get_stage_count() const throw();
+
+		/*!
+			\brief Return the largest number of items that may be in flight at once.
+			\return The count.
+		*/
+		size_t get_token_count() const throw();
+
+		/*!
+			\brief Start the source, the call does not block.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aPriority The priority to schedule the tasks with.
+			\throw std::logic_error If the pipeline is already executing or has no source.
+		*/
+		void schedule(task_dispatcher&, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Block until the source has stopped and every item has left the pipeline, executing other scheduled tasks on the
+			calling thread in the meantime.
+			\throw The first exception thrown by a stage.
+		*/
+		void wait();
+
+		/*!
+			\brief Schedule the pipeline and wait for it to complete.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\param aPriority The priority to schedule the tasks with.
+			\throw The first exception thrown by a stage.
+		*/
+		void run(task_dispatcher&, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Check if the pipeline has completed.
+			\return True if the pipeline is not executing.
+		*/
+		bool is_ready() const throw();
+	};
+}
+
+#endif
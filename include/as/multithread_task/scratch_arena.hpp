@@ -0,0 +1,144 @@
+#ifndef ASMITH_SCRATCH_ARENA_HPP
+#define ASMITH_SCRATCH_ARENA_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+
+namespace as {
+
+	/*!
+		\brief A bump allocator for short lived scratch memory, owned by a single thread.
+		\detail Allocating advances a pointer through a list of blocks, and memory is only released by rewinding to an earlier mark.
+		Blocks are kept when the arena is rewound, so once a thread has reached its peak usage allocating never calls the system
+		allocator or takes a lock. Every thread has its own arena, and thread_pool rewinds it after each task that it executes,
+		so memory allocated by a task is only valid until the task returns. Destructors are never called.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class scratch_arena {
+	private:
+		struct block {
+			block* mNext;		//!< The next block, which is empty if this one is the current block.
+			size_t mSize;		//!< The number of bytes of memory after the header.
+
+			char* begin() throw();
+			char* end() throw();
+		};
+
+		block* mFirst;		//!< The first block, or nullptr if nothing has been allocated yet.
+		block* mCurrent;	//!< The block that is being allocated from.
+		char* mPosition;	//!< The next free byte in mCurrent.
+
+		void* allocate_slow(size_t, size_t);
+	public:
+		enum : size_t {
+			DEFAULT_BLOCK_SIZE = 64 * 1024		//!< The size of the first block.
+		};
+
+		/*!
+			\brief A position in the arena that can be rewound to.
+		*/
+		struct mark {
+			block* mBlock;		//!< The current block, or nullptr if nothing had been allocated.
+			char* mPosition;	//!< The next free byte in mBlock.
+		};
+
+		/*!
+			\brief Rewinds the arena when it goes out of scope.
+		*/
+		class scope {
+		private:
+			scratch_arena& mArena;
+			const mark mMark;
+		public:
+			scope(scratch_arena&) throw();
+			~scope();
+
+			scope(const scope&) = delete;
+			scope& operator=(const scope&) = delete;
+		};
+
+		scratch_arena() throw();
+		~scratch_arena();
+
+		scratch_arena(const scratch_arena&) = delete;
+		scratch_arena& operator=(const scratch_arena&) = delete;
+
+		/*!
+			\brief Return the arena of the calling thread.
+			\return The arena.
+		*/
+		static scratch_arena& local() throw();
+
+		/*!
+			\brief Allocate memory.
+			\param aBytes The number of bytes.
+			\param aAlignment The alignment, which must be a power of two.
+			\return The memory, which is valid until the arena is rewound past it.
+			\throw std::bad_alloc If a new block could not be allocated.
+		*/
+		void* allocate(size_t aBytes, size_t aAlignment = alignof(std::max_align_t)) {
+			char* const tmp = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(mPosition) + aAlignment - 1) & ~static_cast<uintptr_t>(aAlignment - 1));
+			if(mCurrent && tmp <= mCurrent->end() && aBytes <= static_cast<size_t>(mCurrent->end() - tmp)) {
+				mPosition = tmp + aBytes;
+				return tmp;
+			}
+			return allocate_slow(aBytes, aAlignment);
+		}
+
+		/*!
+			\brief Allocate an array of default initialised objects.
+			\param aCount The number of objects.
+			\return The first object.
+			\tparam T The type of object, which must be trivially destructible because the arena never calls destructors.
+		*/
+		template<class T>
+		T* allocate_array(size_t aCount) {
+			static_assert(std::is_trivially_destructible<T>::value, "as::scratch_arena::allocate_array : Type must be trivially destructible");
+			T* const tmp = static_cast<T*>(allocate(sizeof(T) * aCount, alignof(T)));
+			for(size_t i = 0; i < aCount; ++i) new(tmp + i) T;
+			return tmp;
+		}
+
+		/*!
+			\brief Return the current position.
+			\return The mark.
+		*/
+		mark get_mark() const throw();
+
+		/*!
+			\brief Release everything that was allocated after a mark.
+			\param aMark A mark returned by get_mark that has not already been rewound past.
+		*/
+		void rewind(mark) throw();
+
+		/*!
+			\brief Release everything, the blocks are kept for reuse.
+		*/
+		void reset() throw();
+
+		/*!
+			\brief Return the total size of the blocks.
+			\return The number of bytes.
+		*/
+		size_t get_capacity() const throw();
+	};
+}
+
+#endif
@@ -16,21 +16,138 @@
 // limitations under the License.
 
 #include <future>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
 #include "task_interface.hpp"
+#include "task_allocator.hpp"
+#include "futex.hpp"
 
 namespace as {
+	template<class T>
+	class task_handle;
+
+	namespace implementation {
+		template<class T>
+		class task_handle_awaiter;
+
+		/*!
+			\brief Tracks whether a task has produced its return value.
+			\detail A single atomic word holds the state, threads that wait for it block on a futex.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		class task_completion {
+		private:
+			enum : uint32_t {
+				FLAG_READY = 1,			//!< The task has returned or thrown.
+				FLAG_EXCEPTION = 2,		//!< The task has thrown.
+				FLAG_WAITING = 4		//!< At least one thread is blocked waiting for the task.
+			};
+
+			std::atomic<uint32_t> mFlags;	//!< The combination of FLAG_ values.
+			std::exception_ptr mException;	//!< The exception that the task threw.
+
+			void set_ready(uint32_t) throw();
+		public:
+			task_completion();
+
+			/*!
+				\brief Mark the task as having returned.
+				\detail The return value must be stored before this is called.
+			*/
+			void set_value() throw();
+
+			/*!
+				\brief Mark the task as having thrown.
+				\param aException The exception.
+			*/
+			void set_exception(std::exception_ptr) throw();
+
+			/*!
+				\brief Return the state to before the task was executed.
+			*/
+			void reset() throw();
+
+			/*!
+				\brief Check if the task has returned or thrown.
+				\return True if the task has completed.
+			*/
+			bool is_ready() const throw();
+
+			/*!
+				\brief Check if the task threw an exception.
+				\detail Only meaningful once is_ready returns true.
+				\return True if the task threw.
+			*/
+			bool has_exception() const throw();
+
+			/*!
+				\brief Block until the task has returned or thrown.
+			*/
+			void wait() const throw();
+
+			/*!
+				\brief Block until the task has returned or thrown, or a timeout expires.
+				\param aTimeout The maximum time to block for.
+				\return std::future_status::ready or std::future_status::timeout.
+			*/
+			std::future_status wait_for(std::chrono::nanoseconds) const throw();
+
+			/*!
+				\brief Block until the task has returned or thrown, then rethrow the exception if there is one.
+			*/
+			void get() const;
+		};
+	}
 
 	/*!
 		\brief A task with a return value.
 		\detail A specialisation exits for void returns.
+		The return value is stored inside the task and is read through a task_handle.
+		A std::promise is only created if a std::future is requested through task_dispatcher::schedule.
 		\tparam T The return type of the task.
 		\date 19th January 2017
 		\author Adam Smith
 	*/
 	template<class T>
 	class task : public task_interface{
+	public:
+		friend task_handle<T>;
 	private:
-		std::promise<T> mPromise;	//!< The promise that notifies when the task is completed.
+		typename std::aligned_storage<sizeof(T), alignof(T)>::type mValue;	//!< The return value, constructed when mCompletion is ready without an exception.
+		implementation::task_completion mCompletion;							//!< Notifies when the task is completed.
+		std::promise<T>* mPromise;												//!< Adapter for std::future, or nullptr if one has not been requested.
+		bool mTaken;															//!< Set once the return value has been moved out by take.
+
+		T& get_value() throw() {
+			return *reinterpret_cast<T*>(&mValue);
+		}
+
+		const T& get_value(const char* aFunction) {
+			if(mTaken) throw std::logic_error(std::string(aFunction) + " : Return value has already been taken");
+			return get_value();
+		}
+
+		T take_value(const char* aFunction) {
+			if(mTaken) throw std::logic_error(std::string(aFunction) + " : Return value has already been taken");
+			mTaken = true;
+			return std::move(get_value());
+		}
+
+		void destroy_value() throw() {
+			if(mCompletion.is_ready() && ! mCompletion.has_exception()) get_value().~T();
+		}
+
+		void set_promise(std::true_type) {
+			mPromise->set_value(get_value());
+		}
+
+		void set_promise(std::false_type) {
+			// The value can only be given to one owner, so handles to the task can no longer read it
+			mPromise->set_value(take_value("as::task::set_return"));
+		}
 	protected:
 		/*!
 			\brief Set the return value of the task at the end of execution.
@@ -38,52 +155,226 @@ namespace as {
 			\param aValue The return value.
 		*/
 		void set_return(const T& aValue) {
-			mPromise.set_value(aValue);
+			new(&mValue) T(aValue);
+			if(mPromise) set_promise(std::is_copy_constructible<T>());
+			mCompletion.set_value();
+		}
+
+		/*!
+			\brief Set the return value of the task at the end of execution.
+			\detail Calling more than once per execution cycle is undefined behaviour.
+			\param aValue The return value.
+		*/
+		void set_return(T&& aValue) {
+			new(&mValue) T(std::move(aValue));
+			if(mPromise) set_promise(std::is_copy_constructible<T>());
+			mCompletion.set_value();
 		}
 
 		// Inherited from task_interface
 
 		void* get_promise() override {
-			return &mPromise;
+			if(! mPromise) mPromise = new std::promise<T>(std::allocator_arg, slab_allocator<T>());
+			return mPromise;
 		}
 
 		void set_exception(std::exception_ptr aException) override {
-			mPromise.set_exception(aException);
+			if(mPromise) mPromise->set_exception(aException);
+			mCompletion.set_exception(aException);
 		}
 
 		virtual bool on_reinitialise() override {
-			mPromise = std::promise<T>();
+			destroy_value();
+			mCompletion.reset();
+			delete mPromise;
+			mPromise = nullptr;
+			mTaken = false;
 			return true;
 		}
 	public:
-		virtual ~task() {}
+		task() :
+			mPromise(nullptr),
+			mTaken(false)
+		{}
+
+		virtual ~task() {
+			destroy_value();
+			delete mPromise;
+		}
 	};
 
 	template<>
 	class task<void> : public task_interface {
+	public:
+		friend task_handle<void>;
 	private:
-		std::promise<void> mPromise;
+		implementation::task_completion mCompletion;
+		std::promise<void>* mPromise;
 	protected:
 		void set_return() {
-			mPromise.set_value();
+			if(mPromise) mPromise->set_value();
+			mCompletion.set_value();
 		}
 
 		// Inherited from task_interface
 
 		void* get_promise() override {
-			return &mPromise;
+			if(! mPromise) mPromise = new std::promise<void>(std::allocator_arg, slab_allocator<void*>());
+			return mPromise;
 		}
 
 		void set_exception(std::exception_ptr aException) override {
-			mPromise.set_exception(aException);
+			if(mPromise) mPromise->set_exception(aException);
+			mCompletion.set_exception(aException);
 		}
 
 		virtual bool on_reinitialise() override {
-			mPromise = std::promise<void>();
+			mCompletion.reset();
+			delete mPromise;
+			mPromise = nullptr;
 			return true;
 		}
 	public:
-		virtual ~task() {}
+		task() :
+			mPromise(nullptr)
+		{}
+
+		virtual ~task() {
+			delete mPromise;
+		}
+	};
+
+	/*!
+		\brief Waits for and reads the return value of a scheduled task.
+		\detail Unlike std::future this does not allocate, the handle shares ownership of the task and reads its value in place.
+		Any number of handles may refer to the same task. Reinitialising the task invalidates the value seen by existing handles.
+		A value that cannot be copied can only have one consumer: either one handle calls take, or a std::future is requested
+		through task_dispatcher::schedule, in which case the value is moved into the future and the handles cannot read it.
+		\tparam T The return type of the task.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class task_handle {
+	private:
+		friend implementation::task_handle_awaiter<T>;
+
+		std::shared_ptr<task<T>> mTask;	//!< The task, or nullptr if the handle is empty.
+
+		task<T>& get_task(const char* aFunction) const {
+			if(! mTask) throw std::logic_error(std::string(aFunction) + " : Handle is empty");
+			return *mTask;
+		}
+	public:
+		task_handle() {}
+
+		task_handle(std::shared_ptr<task<T>> aTask) :
+			mTask(aTask)
+		{}
+
+		/*!
+			\brief Check if the handle refers to a task.
+			\return True if the handle is not empty.
+		*/
+		bool valid() const throw() {
+			return mTask.get() != nullptr;
+		}
+
+		/*!
+			\brief Check if the task has returned or thrown.
+			\return True if get will not block, false if it will or the handle is empty.
+		*/
+		bool is_ready() const throw() {
+			return mTask && mTask->mCompletion.is_ready();
+		}
+
+		/*!
+			\brief Block until the task has returned or thrown.
+			\throw std::logic_error If the handle is empty.
+		*/
+		void wait() const {
+			get_task("as::task_handle::wait").mCompletion.wait();
+		}
+
+		/*!
+			\brief Block until the task has returned or thrown, or a timeout expires.
+			\param aPeriod The maximum time to block for.
+			\return std::future_status::ready or std::future_status::timeout.
+			\throw std::logic_error If the handle is empty.
+		*/
+		template<class R, class P>
+		std::future_status wait_for(const std::chrono::duration<R,P>& aPeriod) const {
+			return get_task("as::task_handle::wait_for").mCompletion.wait_for(std::chrono::duration_cast<std::chrono::nanoseconds>(aPeriod));
+		}
+
+		/*!
+			\brief Block until the task has returned, then return its value.
+			\detail If the task threw then the exception is rethrown.
+			\return The return value.
+			\throw std::logic_error If the handle is empty or the value has been taken.
+		*/
+		const T& get() const {
+			task<T>& tmp = get_task("as::task_handle::get");
+			tmp.mCompletion.get();
+			return tmp.get_value("as::task_handle::get");
+		}
+
+		/*!
+			\brief Block until the task has returned, then move its value out of the task.
+			\detail If the task threw then the exception is rethrown. Lets a value that cannot be copied be consumed, only one
+			consumer may take the value and afterwards get and take throw until the task is reinitialised.
+			\return The return value.
+			\throw std::logic_error If the handle is empty or the value has already been taken.
+		*/
+		T take() const {
+			task<T>& tmp = get_task("as::task_handle::take");
+			tmp.mCompletion.get();
+			return tmp.take_value("as::task_handle::take");
+		}
+	};
+
+	template<>
+	class task_handle<void> {
+	private:
+		friend implementation::task_handle_awaiter<void>;
+
+		std::shared_ptr<task<void>> mTask;
+
+		task<void>& get_task(const char* aFunction) const {
+			if(! mTask) throw std::logic_error(std::string(aFunction) + " : Handle is empty");
+			return *mTask;
+		}
+	public:
+		task_handle() {}
+
+		task_handle(std::shared_ptr<task<void>> aTask) :
+			mTask(aTask)
+		{}
+
+		bool valid() const throw() {
+			return mTask.get() != nullptr;
+		}
+
+		bool is_ready() const throw() {
+			return mTask && mTask->mCompletion.is_ready();
+		}
+
+		void wait() const {
+			get_task("as::task_handle::wait").mCompletion.wait();
+		}
+
+		template<class R, class P>
+		std::future_status wait_for(const std::chrono::duration<R,P>& aPeriod) const {
+			return get_task("as::task_handle::wait_for").mCompletion.wait_for(std::chrono::duration_cast<std::chrono::nanoseconds>(aPeriod));
+		}
+
+		void get() const {
+			get_task("as::task_handle::get").mCompletion.get();
+		}
+
+		void take() const {
+			get_task("as::task_handle::take").mCompletion.get();
+		}
 	};
 }
 
@@ -0,0 +1,229 @@
+#ifndef ASMITH_TASK_ALLOCATOR_HPP
+#define ASMITH_TASK_ALLOCATOR_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+#include "task_interface.hpp"
+
+namespace as {
+	namespace implementation {
+		/*!
+			\brief Allocate memory from the calling thread's slab cache.
+			\detail Small blocks are taken from a per-thread free list without locking, blocks larger than
+			SLAB_MAX_SIZE or with an alignment larger than SLAB_ALIGNMENT are passed to the global allocator.
+			\param aBytes The size of the block.
+			\param aAlignment The alignment of the block.
+			\return The address of the block.
+		*/
+		void* slab_allocate(size_t, size_t);
+
+		/*!
+			\brief Return memory allocated by slab_allocate.
+			\detail The block does not need to be returned by the thread that allocated it.
+			\param aPtr The address of the block.
+			\param aBytes The size that the block was allocated with.
+			\param aAlignment The alignment that the block was allocated with.
+		*/
+		void slab_deallocate(void*, size_t, size_t) throw();
+
+		enum {
+			SLAB_ALIGNMENT = 16,	//!< The alignment of every block in a slab.
+			SLAB_MAX_SIZE = 1024	//!< The largest block that is served from a slab.
+		};
+	}
+
+	/*!
+		\brief A standard library compatible allocator that uses per-thread slab caches.
+		\detail Used for task objects, their shared_ptr control blocks and promise states so that
+		scheduling in a steady state does not go through the global allocator.
+		\tparam T The type of object that is allocated.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class slab_allocator {
+	public:
+		typedef T value_type;
+
+		template<class T2>
+		struct rebind {
+			typedef slab_allocator<T2> other;
+		};
+
+		slab_allocator() throw() {}
+
+		template<class T2>
+		slab_allocator(const slab_allocator<T2>&) throw() {}
+
+		T* allocate(size_t aCount) {
+			return static_cast<T*>(implementation::slab_allocate(sizeof(T) * aCount, alignof(T)));
+		}
+
+		void deallocate(T* aPtr, size_t aCount) throw() {
+			implementation::slab_deallocate(aPtr, sizeof(T) * aCount, alignof(T));
+		}
+
+		template<class T2>
+		bool operator==(const slab_allocator<T2>&) const throw() {
+			return true;
+		}
+
+		template<class T2>
+		bool operator!=(const slab_allocator<T2>&) const throw() {
+			return false;
+		}
+	};
+
+	/*!
+		\brief Recycles completed tasks of a single type.
+		\detail When the last reference to a task created by the pool is released, the task is reinitialised
+		and kept for the next call to make_task instead of being destroyed.
+		The pool may be destroyed before the tasks that it created.
+		\tparam T The type of task, which must inherit from task_interface.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	template<class T>
+	class task_pool {
+	private:
+		struct state {
+			std::vector<T*> mTasks;		//!< Reinitialised tasks that are ready to be reused.
+			std::mutex mLock;			//!< Thread-safe access to mTasks.
+			const size_t mCapacity;		//!< The maximum number of tasks that are kept.
+
+			state(size_t aCapacity) :
+				mCapacity(aCapacity)
+			{
+				mTasks.reserve(aCapacity);
+			}
+
+			~state() {
+				for(T* i : mTasks) destroy(i);
+			}
+		};
+
+		class recycler {
+		private:
+			// A recycled task keeps its old control block alive through enable_shared_from_this, so a strong reference would be circular
+			std::weak_ptr<state> mState;
+		public:
+			recycler(std::shared_ptr<state> aState) :
+				mState(aState)
+			{}
+
+			void operator()(T* aTask) const throw() {
+				const std::shared_ptr<state> pool = mState.lock();
+				if(pool && aTask->get_state() == task_interface::STATE_COMPLETE && aTask->reinitialise()) {
+					std::lock_guard<std::mutex> lock(pool->mLock);
+					if(pool->mTasks.size() < pool->mCapacity) {
+						pool->mTasks.push_back(aTask);
+						return;
+					}
+				}
+				destroy(aTask);
+			}
+		};
+
+		std::shared_ptr<state> mState;
+
+		static void destroy(T* aTask) throw() {
+			aTask->~T();
+			slab_allocator<T>().deallocate(aTask, 1);
+		}
+
+		T* pop() throw() {
+			std::lock_guard<std::mutex> lock(mState->mLock);
+			if(mState->mTasks.empty()) return nullptr;
+			T* const tmp = mState->mTasks.back();
+			mState->mTasks.pop_back();
+			return tmp;
+		}
+
+		T* construct(T* aMemory) {
+			// A recycled task has already been reinitialised
+			if(aMemory) return aMemory;
+			aMemory = slab_allocator<T>().allocate(1);
+			try {
+				return new(aMemory) T();
+			}catch(...) {
+				slab_allocator<T>().deallocate(aMemory, 1);
+				throw;
+			}
+		}
+
+		template<class A, class... ARGS>
+		T* construct(T* aMemory, A&& aArg, ARGS&&... aArgs) {
+			// The arguments may differ from the ones the recycled task was created with, so only its memory is reused
+			if(aMemory) aMemory->~T();
+			else aMemory = slab_allocator<T>().allocate(1);
+			try {
+				return new(aMemory) T(std::forward<A>(aArg), std::forward<ARGS>(aArgs)...);
+			}catch(...) {
+				slab_allocator<T>().deallocate(aMemory, 1);
+				throw;
+			}
+		}
+	public:
+		/*!
+			\brief Create a new pool.
+			\param aCapacity The maximum number of completed tasks that are kept for reuse.
+		*/
+		task_pool(size_t aCapacity = 64) :
+			mState(std::allocate_shared<state>(slab_allocator<state>(), aCapacity))
+		{}
+
+		/*!
+			\brief Create a task, reusing a completed one if possible.
+			\param aArgs The constructor arguments of the task.
+			\return The task.
+		*/
+		template<class... ARGS>
+		std::shared_ptr<T> make(ARGS&&... aArgs) {
+			// If the control block cannot be allocated then shared_ptr passes the task to the recycler
+			return std::shared_ptr<T>(construct(pop(), std::forward<ARGS>(aArgs)...), recycler(mState), slab_allocator<T>());
+		}
+	};
+
+	/*!
+		\brief Create a task with its shared_ptr control block in a single allocation from the calling thread's slab cache.
+		\param aArgs The constructor arguments of the task.
+		\tparam T The type of task.
+		\return The task.
+	*/
+	template<class T, class... ARGS>
+	std::shared_ptr<T> make_task(ARGS&&... aArgs) {
+		return std::allocate_shared<T>(slab_allocator<T>(), std::forward<ARGS>(aArgs)...);
+	}
+
+	/*!
+		\brief Create a task, reusing a completed one from a pool if possible.
+		\param aPool The pool to take the task from.
+		\param aArgs The constructor arguments of the task.
+		\tparam T The type of task.
+		\return The task.
+	*/
+	template<class T, class... ARGS>
+	std::shared_ptr<T> make_task(task_pool<T>& aPool, ARGS&&... aArgs) {
+		return aPool.make(std::forward<ARGS>(aArgs)...);
+	}
+}
+
+#endif
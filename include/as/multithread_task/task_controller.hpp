@@ -15,6 +15,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdint>
+#include <stdexcept>
+#include "scratch_arena.hpp"
 #include "task_dispatcher.hpp"
 
 namespace as {
@@ -26,7 +29,51 @@ namespace as {
 		virtual bool on_cancel(task_interface&) throw() = 0;
 		virtual bool on_reschedule(task_interface&, task_dispatcher::priority) throw() = 0;
 	public:
+		enum : size_t {
+			NO_WORKER = SIZE_MAX	//!< Returned by get_worker_index when the task is executed by a thread outside of the dispatcher.
+		};
+
 		virtual ~task_controller() {}
+
+		/*!
+			\brief Return the dispatcher that is executing the task.
+			\detail A suspended task uses this to schedule itself again.
+			The default implementation throws, so controllers written before this was added still compile.
+			\return The dispatcher.
+			\throw std::logic_error If the controller does not know its dispatcher.
+		*/
+		virtual task_dispatcher& get_dispatcher() {
+			throw std::logic_error("as::task_controller::get_dispatcher : The controller does not provide its dispatcher");
+		}
+
+		/*!
+			\brief Return the index of the worker thread that is executing the task.
+			\detail Lets a task index per-worker state, such as an array of get_worker_count() elements, without locking.
+			The default implementation returns NO_WORKER.
+			\return An index in the range [0, get_worker_count()), or NO_WORKER if the task is executed by a thread that is
+			not one of the dispatcher's workers, for example one that is waiting for another task.
+		*/
+		virtual size_t get_worker_index() const throw() {
+			return NO_WORKER;
+		}
+
+		/*!
+			\brief Return the number of worker threads that the dispatcher may run.
+			\detail The default implementation returns 0.
+			\return The count.
+		*/
+		virtual size_t get_worker_count() const throw() {
+			return 0;
+		}
+
+		/*!
+			\brief Return the scratch arena of the thread that is executing the task.
+			\detail Memory allocated from it is released when the task returns.
+			\return The arena.
+		*/
+		scratch_arena& get_scratch_arena() throw() {
+			return scratch_arena::local();
+		}
 	};
 }
 
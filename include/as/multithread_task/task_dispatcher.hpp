@@ -15,9 +15,16 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <memory>
 #include <future>
+#include <stdexcept>
+#include <vector>
 #include "task_interface.hpp"
+#include "task.hpp"
+#include "callable_task.hpp"
 
 namespace as {
 
@@ -28,8 +35,17 @@ namespace as {
 	*/
 	class task_dispatcher {
 	public:
+		friend class task_graph;
+
 		typedef implementation::task_priority priority;		//!< Defines priority levels for scheduled tasks.
 		typedef std::shared_ptr<task_interface> task_ptr;	//!< Smart pointer containing a task.
+	private:
+		enum : uint32_t {
+			TICKET_QUEUED = 1,				//!< Set while the entry is still queued.
+			TICKET_PRIORITY_SHIFT = 1,		//!< The position of the priority the entry is queued at.
+			TICKET_PRIORITY_MASK = 7 << 1,	//!< The bits of the priority the entry is queued at.
+			TICKET_SEQUENCE = 16			//!< Added each time the task is queued, so that an old entry never matches a new one.
+		};
 	protected:
 		/*!
 			\brief Schedule a task.
@@ -37,24 +53,322 @@ namespace as {
 			\param aPriority The priority to schedule the task with.
 		*/
 		virtual void schedule_task(task_ptr, priority) = 0;
+
+		/*!
+			\brief Schedule several tasks at once.
+			\detail The default implementation calls schedule_task for each task.
+			\param aTasks The tasks to schedule.
+			\param aCount The number of tasks.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		virtual void schedule_tasks(const task_ptr* aTasks, size_t aCount, priority aPriority) {
+			for(size_t i = 0; i < aCount; ++i) schedule_task(aTasks[i], aPriority);
+		}
+
+		/*!
+			\brief Record when a task was queued, so that the time it waits before executing can be measured.
+			\param aTask The task.
+			\param aTime The time in steady_clock nanoseconds, or 0 if it is not recorded.
+		*/
+		static void set_schedule_time(task_interface& aTask, int64_t aTime) throw() {
+			aTask.mScheduleTime = aTime;
+		}
+
+		/*!
+			\brief Return when a task was queued.
+			\param aTask The task.
+			\return The time in steady_clock nanoseconds, or 0 if it was not recorded.
+		*/
+		static int64_t get_schedule_time(const task_interface& aTask) throw() {
+			return aTask.mScheduleTime;
+		}
+
+		/*!
+			\brief Tell the continuations of a task that it has been cancelled before it was executed.
+			\detail Dispatchers call this once a task has been removed from their queues and will not be executed.
+			\param aTask The task.
+		*/
+		static void notify_cancelled(task_interface& aTask) throw() {
+			aTask.notify_cancelled();
+		}
+
+		/*!
+			\brief Record the priority a task was scheduled with, so that it keeps it when it is queued again after pausing.
+			\param aTask The task.
+			\param aPriority The priority.
+		*/
+		static void set_priority(task_interface& aTask, priority aPriority) throw() {
+			aTask.mPriority = aPriority;
+		}
+
+		/*!
+			\brief Return the priority a task was last scheduled with.
+			\param aTask The task.
+			\return The priority.
+		*/
+		static priority get_priority(const task_interface& aTask) throw() {
+			return aTask.mPriority;
+		}
+
+		/*!
+			\brief Mark a task as queued by this dispatcher.
+			\detail The ticket identifies the new queue entry. An entry is taken by claiming its ticket, so cancelling a task
+			only needs to claim it and any entry that is left behind in a queue is recognised and skipped when it is reached.
+			\param aTask The task.
+			\param aPriority The priority of the queue that the entry is added to.
+			\return The ticket.
+		*/
+		uint32_t enqueue_ticket(task_interface& aTask, priority aPriority) throw() {
+			aTask.mQueueOwner.store(this, std::memory_order_relaxed);
+			const uint32_t ticket = ((aTask.mQueueTicket.load(std::memory_order_relaxed) & ~(TICKET_SEQUENCE - 1)) + TICKET_SEQUENCE) |
+				(static_cast<uint32_t>(aPriority) << TICKET_PRIORITY_SHIFT) | TICKET_QUEUED;
+			aTask.mQueueTicket.store(ticket, std::memory_order_release);
+			return ticket;
+		}
+
+		/*!
+			\brief Take a queue entry.
+			\param aTask The task of the entry.
+			\param aTicket The ticket of the entry.
+			\return False if the entry has already been taken, or cancelled.
+		*/
+		static bool claim_ticket(task_interface& aTask, uint32_t aTicket) throw() {
+			uint32_t expected = aTicket;
+			return aTask.mQueueTicket.compare_exchange_strong(expected, aTicket & ~static_cast<uint32_t>(TICKET_QUEUED), std::memory_order_acq_rel);
+		}
+
+		/*!
+			\brief Take the current queue entry of a task, if it was queued by this dispatcher.
+			\param aTask The task.
+			\param aPriority Set to the priority of the queue that holds the entry.
+			\return False if the task is not queued by this dispatcher.
+		*/
+		bool claim_queued(task_interface& aTask, priority& aPriority) throw() {
+			const uint32_t ticket = aTask.mQueueTicket.load(std::memory_order_acquire);
+			if((ticket & TICKET_QUEUED) == 0 || aTask.mQueueOwner.load(std::memory_order_relaxed) != this) return false;
+			if(! claim_ticket(aTask, ticket)) return false;
+			aPriority = get_ticket_priority(ticket);
+			return true;
+		}
+
+		/*!
+			\brief Move a queue entry to a different priority.
+			\param aTask The task of the entry.
+			\param aTicket The ticket of the entry, it is updated to the new ticket.
+			\param aPriority The new priority.
+			\return False if the entry has already been taken, or cancelled.
+		*/
+		static bool move_ticket(task_interface& aTask, uint32_t& aTicket, priority aPriority) throw() {
+			uint32_t expected = aTicket;
+			const uint32_t ticket = (aTicket & ~static_cast<uint32_t>(TICKET_PRIORITY_MASK)) | (static_cast<uint32_t>(aPriority) << TICKET_PRIORITY_SHIFT);
+			if(! aTask.mQueueTicket.compare_exchange_strong(expected, ticket, std::memory_order_acq_rel)) return false;
+			aTicket = ticket;
+			return true;
+		}
+
+		/*!
+			\brief Check if a queue entry can still be taken.
+			\param aTask The task of the entry.
+			\param aTicket The ticket of the entry.
+			\return False if the entry has been taken or cancelled, and should be discarded.
+		*/
+		static bool is_ticket_current(const task_interface& aTask, uint32_t aTicket) throw() {
+			return aTask.mQueueTicket.load(std::memory_order_acquire) == aTicket;
+		}
+
+		/*!
+			\brief Check if a task is waiting in the queue of a dispatcher.
+			\param aTask The task.
+			\return True if the current queue entry of the task has not been taken.
+		*/
+		static bool is_queued(const task_interface& aTask) throw() {
+			return (aTask.mQueueTicket.load(std::memory_order_acquire) & TICKET_QUEUED) != 0;
+		}
+
+		/*!
+			\brief Return the priority of the queue that holds an entry.
+			\param aTicket The ticket of the entry.
+			\return The priority.
+		*/
+		static priority get_ticket_priority(uint32_t aTicket) throw() {
+			return static_cast<priority>((aTicket & TICKET_PRIORITY_MASK) >> TICKET_PRIORITY_SHIFT);
+		}
 	public:
+		enum : uint32_t {
+			HELP_WAIT_US = 100	//!< The longest that a helping wait blocks for in microseconds before looking for scheduled tasks again.
+		};
+
 		/*!
 			\brief Destroy the dispatcher.
 		*/
 		virtual ~task_dispatcher() {}
 
 		/*!
-			\brief Schedule a task.
+			\brief Remove one scheduled task and execute it on the calling thread.
+			\detail Lets a thread that is waiting for a task do useful work instead of blocking.
+			The default implementation does nothing.
+			\return True if a task was executed, false if no task was ready.
+		*/
+		virtual bool execute_scheduled_task() {
+			return false;
+		}
+
+		/*!
+			\brief Cancel a task that is queued but has not started executing, or is paused and waiting to resume.
+			\detail The task is not executed unless it is scheduled again, a paused task then resumes from where it paused.
+			The default implementation does nothing.
+			\param aTask The task.
+			\return True if the task was cancelled, false if it is not queued by this dispatcher or is executing.
+		*/
+		virtual bool cancel(task_interface&) throw() {
+			return false;
+		}
+
+		/*!
+			\brief Execute scheduled tasks on the calling thread until a condition is met or a timeout expires.
+			\detail This is the loop behind every helping wait, it prevents a worker thread that waits from deadlocking a small pool.
+			When no task is ready the thread blocks, but only for HELP_WAIT_US at a time so that tasks which are scheduled in the
+			meantime are not left waiting. A task that is executed while waiting may overrun the timeout.
+			\param aDone Returns true once the wait is over.
+			\param aBlock Called with the longest time to block for when no task is ready, it may return early.
+			\param aTimeout The longest time to wait for, or std::chrono::nanoseconds::max() to wait until the condition is met.
+			\return True if the condition was met, false if the timeout expired first.
+		*/
+		template<class D, class B>
+		bool help_until(const D& aDone, const B& aBlock, std::chrono::nanoseconds aTimeout = std::chrono::nanoseconds::max()) {
+			typedef std::chrono::steady_clock clock;
+			const bool bounded = aTimeout != std::chrono::nanoseconds::max();
+			const clock::time_point deadline = bounded ? clock::now() + aTimeout : clock::time_point::max();
+			while(! aDone()) {
+				std::chrono::nanoseconds slice = std::chrono::microseconds(HELP_WAIT_US);
+				if(bounded) {
+					const std::chrono::nanoseconds remaining = deadline - clock::now();
+					if(remaining.count() <= 0) return false;
+					slice = std::min(slice, remaining);
+				}
+				if(! execute_scheduled_task()) aBlock(slice);
+			}
+			return true;
+		}
+
+		/*!
+			\brief Block until a task has completed, executing other scheduled tasks on the calling thread in the meantime.
+			\param aHandle The task to wait for.
+			\throw std::logic_error If the handle is empty.
+		*/
+		template<class R>
+		void wait(const task_handle<R>& aHandle) {
+			if(! aHandle.valid()) throw std::logic_error("as::task_dispatcher::wait : Handle is empty");
+			help_until(
+				[&aHandle]()->bool { return aHandle.is_ready(); },
+				[&aHandle](std::chrono::nanoseconds aSlice)->void { aHandle.wait_for(aSlice); }
+			);
+		}
+
+		/*!
+			\brief Block until a task has completed or a timeout expires, executing other scheduled tasks on the calling thread in the meantime.
+			\param aHandle The task to wait for.
+			\param aPeriod The longest time to wait for.
+			\return std::future_status::ready or std::future_status::timeout.
+			\throw std::logic_error If the handle is empty.
+		*/
+		template<class R, class REP, class P>
+		std::future_status wait_for(const task_handle<R>& aHandle, const std::chrono::duration<REP,P>& aPeriod) {
+			if(! aHandle.valid()) throw std::logic_error("as::task_dispatcher::wait_for : Handle is empty");
+			return help_until(
+				[&aHandle]()->bool { return aHandle.is_ready(); },
+				[&aHandle](std::chrono::nanoseconds aSlice)->void { aHandle.wait_for(aSlice); },
+				std::chrono::duration_cast<std::chrono::nanoseconds>(aPeriod)
+			) ? std::future_status::ready : std::future_status::timeout;
+		}
+
+		/*!
+			\brief Block until a counter reaches 0, executing other scheduled tasks on the calling thread in the meantime.
+			\detail The thread that brings the counter to 0 should call futex_wake_all on it so that the wait ends promptly.
+			\param aCounter The counter.
+		*/
+		void wait(const std::atomic<uint32_t>&);
+
+		/*!
+			\brief Schedule a task and return a std::future for its result.
+			\detail The std::promise behind the future is only allocated when this is called, schedule_handle avoids it.
 			\param aTask The task to schedule.
 			\param aPriority The priority to schedule the task with.
-			\tparam R The return type of the task (the type of the std::promise<?> object).
+			\tparam R The return type of the task.
+			\throw std::invalid_argument If aTask does not inherit from task<R>.
 		*/
 		template<class R>
-		std::future<R> schedule(task_ptr aTask, priority aPriority = PRIORITY_MEDIUM) {
+		std::future<R> schedule(task_ptr aTask, priority aPriority = priority::PRIORITY_MEDIUM) {
+			if(! dynamic_cast<task<R>*>(aTask.get())) throw std::invalid_argument("as::task_dispatcher::schedule : Task does not return the requested type");
+			// The promise must exist before the task can complete
+			std::future<R> future = static_cast<std::promise<R>*>(aTask->get_promise())->get_future();
 			schedule_task(aTask, aPriority);
-			return static_cast<std::promise<R>*>(aTask->get_promise())->get_future();
+			return future;
+		}
+
+		/*!
+			\brief Schedule a task and return a handle for its result.
+			\param aTask The task to schedule.
+			\param aPriority The priority to schedule the task with.
+			\tparam R The return type of the task.
+		*/
+		template<class R>
+		task_handle<R> schedule_handle(std::shared_ptr<task<R>> aTask, priority aPriority = priority::PRIORITY_MEDIUM) {
+			schedule_task(aTask, aPriority);
+			return task_handle<R>(aTask);
+		}
+
+		/*!
+			\brief Schedule a callable without writing a task class for it.
+			\detail The callable is stored inside a task of a fixed size, with the task and its control block allocated together
+			from the calling thread's slab cache. A callable that accepts a task_controller& is passed the controller.
+			Move-only callables are supported.
+			\param aFunction The callable, which is moved or copied into the task.
+			\param aPriority The priority to schedule the task with.
+			\return A handle for the value returned by the callable.
+		*/
+		template<class F>
+		task_handle<implementation::callable_result<F>> submit(F&& aFunction, priority aPriority = priority::PRIORITY_MEDIUM) {
+			typedef implementation::callable_result<F> result;
+			return schedule_handle<result>(make_task<implementation::callable_task<result>>(std::forward<F>(aFunction)), aPriority);
+		}
+
+		/*!
+			\brief Schedule a callable without keeping a handle to it.
+			\detail The value returned by the callable is discarded, and exceptions that it throws are ignored.
+			\param aFunction The callable, which is moved or copied into the task.
+			\param aPriority The priority to schedule the task with.
+		*/
+		template<class F>
+		void post(F&& aFunction, priority aPriority = priority::PRIORITY_MEDIUM) {
+			schedule_task(make_task<implementation::callable_task<void>>(std::forward<F>(aFunction)), aPriority);
+		}
+
+		/*!
+			\brief Schedule a batch of tasks.
+			\detail This is cheaper than scheduling each task separately, the batch is queued together and only
+			as many idle threads as there are tasks are woken.
+			\param aTasks The tasks to schedule.
+			\param aCount The number of tasks.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		void schedule_bulk(const task_ptr* aTasks, size_t aCount, priority aPriority = priority::PRIORITY_MEDIUM) {
+			schedule_tasks(aTasks, aCount, aPriority);
+		}
+
+		/*!
+			\brief Schedule a batch of tasks.
+			\param aTasks The tasks to schedule.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		template<class A>
+		void schedule_bulk(const std::vector<task_ptr, A>& aTasks, priority aPriority = priority::PRIORITY_MEDIUM) {
+			schedule_tasks(aTasks.data(), aTasks.size(), aPriority);
 		}
 	};
 }
 
+// Callables passed to submit may take a task_controller&, it includes this header so it can only be included once task_dispatcher is complete
+#include "task_controller.hpp"
+
 #endif
\ No newline at end of file
@@ -0,0 +1,157 @@
+#ifndef ASMITH_TASK_GRAPH_HPP
+#define ASMITH_TASK_GRAPH_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "task_dispatcher.hpp"
+
+namespace as {
+
+	/*!
+		\brief Executes a set of tasks in an order given by the dependencies between them.
+		\detail Each task keeps a count of the predecessors that have not completed yet. When a task completes it decrements
+		the counts of its successors, and any successor whose count reaches zero is scheduled immediately by the thread that
+		completed its last predecessor, so no thread blocks between stages.
+		A successor is executed even if a predecessor threw an exception, the exception can be read through a task_handle.
+		A task that is cancelled through the dispatcher before it executes also releases its successors, so wait still returns.
+		The graph cannot be modified while it is executing. Tasks must be reinitialised before the graph is scheduled again.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class task_graph {
+	private:
+		struct state;
+
+		struct vertex : public implementation::task_continuation {
+			task_dispatcher::task_ptr mTask;			//!< The task to execute.
+			std::vector<vertex*> mSuccessors;			//!< The vertices that depend on this one.
+			state& mState;								//!< The graph that owns the vertex.
+			std::atomic_size_t mPredecessors;			//!< The number of predecessors that have not completed during the current execution.
+			std::atomic_bool mReleased;					//!< Set once the successors have been released during the current execution.
+			size_t mPredecessorCount;					//!< The total number of predecessors.
+			const task_dispatcher::priority mPriority;	//!< The priority to schedule the task with.
+
+			vertex(state&, task_dispatcher::task_ptr, task_dispatcher::priority);
+
+			/*!
+				\brief Schedule the successors whose last predecessor this was, at most once per execution.
+			*/
+			void release() throw();
+
+			// Inherited from task_continuation
+
+			void on_complete() throw() override;
+			void on_cancel() throw() override;
+		};
+
+		struct state : public std::enable_shared_from_this<state> {
+			std::vector<std::unique_ptr<vertex>> mVertices;				//!< Every vertex in the order that they were added.
+			std::unordered_map<task_interface*, vertex*> mLookup;		//!< Finds the vertex of a task.
+			task_dispatcher* mDispatcher;								//!< The dispatcher that the graph was last scheduled with.
+			std::atomic<uint32_t> mRemaining;							//!< The number of tasks that have not completed during the current execution.
+
+			state();
+		};
+
+		std::shared_ptr<state> mState;
+
+		vertex& get_vertex(task_dispatcher::task_ptr, task_dispatcher::priority);
+		void check_acyclic() const;
+	public:
+		/*!
+			\brief Refers to a task that has been added to a graph.
+		*/
+		class node {
+		private:
+			friend task_graph;
+
+			task_graph* mGraph;
+			vertex* mVertex;
+
+			node(task_graph&, vertex&);
+		public:
+			/*!
+				\brief Add a task that is executed after this one has completed.
+				\param aTask The task to add.
+				\param aPriority The priority to schedule the task with, ignored if the task is already in the graph.
+				\return The node of the added task, so that further continuations can be chained.
+			*/
+			node then(task_dispatcher::task_ptr, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM);
+
+			/*!
+				\brief Return the task that this node refers to.
+				\return The task.
+			*/
+			task_dispatcher::task_ptr get_task() const throw();
+		};
+
+		/*!
+			\brief Create an empty graph.
+		*/
+		task_graph();
+
+		/*!
+			\brief Destroy the graph, waiting for the current execution to complete.
+		*/
+		~task_graph();
+
+		task_graph(const task_graph&) = delete;
+		task_graph& operator=(const task_graph&) = delete;
+
+		/*!
+			\brief Add a task to the graph.
+			\param aTask The task to add.
+			\param aPriority The priority to schedule the task with, ignored if the task is already in the graph.
+			\return The node of the task.
+			\throw std::logic_error If the graph is executing.
+		*/
+		node add(task_dispatcher::task_ptr, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Make one task wait for another to complete before it is executed.
+			\detail Tasks that are not in the graph yet are added with PRIORITY_MEDIUM.
+			\param aPredecessor The task that must complete first.
+			\param aSuccessor The task that depends on aPredecessor.
+			\throw std::logic_error If the graph is executing.
+		*/
+		void add_edge(task_dispatcher::task_ptr, task_dispatcher::task_ptr);
+
+		/*!
+			\brief Schedule every task that has no predecessors, the rest are scheduled as their dependencies complete.
+			\detail The call does not block.
+			\param aDispatcher The dispatcher to schedule tasks with.
+			\throw std::invalid_argument If the dependencies contain a cycle.
+			\throw std::logic_error If the graph is already executing, or a task has not been reinitialised since it was last executed.
+		*/
+		void schedule(task_dispatcher&);
+
+		/*!
+			\brief Block until every task in the graph has completed, executing other scheduled tasks on the calling thread in the meantime.
+		*/
+		void wait() throw();
+
+		/*!
+			\brief Check if every task in the graph has completed.
+			\return True if the graph is not executing.
+		*/
+		bool is_ready() const throw();
+	};
+}
+
+#endif
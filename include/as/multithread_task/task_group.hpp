@@ -19,40 +19,74 @@
 #include "task_dispatcher.hpp"
 
 namespace as {
+	namespace implementation {
+		class task_group_awaiter;
+	}
+
 	class task_group {
 	private:
+		friend implementation::task_group_awaiter;
+
 		class task_wrapper {
 		public:
 			virtual ~task_wrapper() {}
 
-			virtual void wait() = 0;
-			virtual std::future_status wait_for(const std::chrono::milliseconds&) = 0;
+			virtual bool is_ready() const = 0;
+			virtual void wait(task_dispatcher*) = 0;
+			virtual std::future_status wait_for(task_dispatcher*, std::chrono::nanoseconds) = 0;
 			virtual void set_return(void*) = 0;
-			virtual void schedule(task_dispatcher&, task_dispatcher::priority) = 0;
+			virtual task_dispatcher::task_ptr prepare_schedule() = 0;
+			virtual task_dispatcher::task_ptr get_scheduled_task() const = 0;
+			virtual bool cancel(task_dispatcher&) = 0;
 		};
 
 		template<class T>
 		class task_wrapper_2 : public task_wrapper {
 		private:
-			task_dispatcher::task_ptr mTask;
-			std::future<T> mFuture;
+			std::shared_ptr<task<T>> mTask;
+			task_handle<T> mHandle;
 			T* mReturn;
+			bool mStored;	//!< Set once the return value of the current execution has been stored in mReturn.
+
+			void store_return(std::true_type) {
+				*mReturn = mHandle.get();
+			}
+
+			void store_return(std::false_type) {
+				*mReturn = mHandle.take();
+			}
+
+			void store_return() {
+				// The value is only stored once, a value that cannot be copied is moved out of the task
+				if(! mReturn || mStored) return;
+				store_return(std::is_copy_assignable<T>());
+				mStored = true;
+			}
 		public:
-			task_wrapper_2(task_dispatcher::task_ptr aTask) :
+			task_wrapper_2(std::shared_ptr<task<T>> aTask) :
 				mTask(aTask),
-				mReturn(nullptr)
+				mReturn(nullptr),
+				mStored(false)
 			{}
 
 			// Inherited from task_wrapper
 
-			void wait() override {
-				mFuture.wait();
-				if(mReturn) *mReturn = mFuture.get();
+			bool is_ready() const override {
+				return ! mHandle.valid() || mHandle.is_ready();
+			}
+
+			void wait(task_dispatcher* aDispatcher) override {
+				if(! mHandle.valid()) return;
+				if(aDispatcher) aDispatcher->wait(mHandle);
+				else mHandle.wait();
+				store_return();
 			}
 
-			std::future_status wait_for(const std::chrono::milliseconds& aDuration) override {
-				const std::future_status tmp = mFuture.wait_for(aDuration);
-				if(tmp == std::future_status::ready && mReturn) *mReturn = mFuture.get();
+			std::future_status wait_for(task_dispatcher* aDispatcher, std::chrono::nanoseconds aDuration) override {
+				// A task that was never scheduled or has been cancelled has nothing left to wait for
+				if(! mHandle.valid()) return std::future_status::ready;
+				const std::future_status tmp = aDispatcher ? aDispatcher->wait_for(mHandle, aDuration) : mHandle.wait_for(aDuration);
+				if(tmp == std::future_status::ready) store_return();
 				return tmp;
 			}
 
@@ -60,67 +94,113 @@ namespace as {
 				mReturn = static_cast<T*>(aPtr);
 			}
 			
-			void schedule(task_dispatcher& aTask, task_dispatcher::priority aPriority) override {
-				mFuture = aTask.schedule<T>(mTask, aPriority);
-			}
-		};
-
-		template<>
-		class task_wrapper_2<void> : public task_wrapper {
-		private:
-			task_dispatcher::task_ptr mTask;
-			std::future<void> mFuture;
-		public:
-			task_wrapper_2(task_dispatcher::task_ptr aTask) :
-				mTask(aTask)
-			{}
-
-			// Inherited from task_wrapper
-
-			void wait() override {
-				mFuture.wait();
-			}
-
-			std::future_status wait_for(const std::chrono::milliseconds& aDuration) override {
-				return mFuture.wait_for(aDuration);
+			task_dispatcher::task_ptr prepare_schedule() override {
+				mHandle = task_handle<T>(mTask);
+				mStored = false;
+				return mTask;
 			}
 
-			void set_return(void* aPtr) override {
-				
+			task_dispatcher::task_ptr get_scheduled_task() const override {
+				return mHandle.valid() ? mTask : nullptr;
 			}
 
-			void schedule(task_dispatcher& aTask, task_dispatcher::priority aPriority) override {
-				mFuture = aTask.schedule<void>(mTask, aPriority);
+			bool cancel(task_dispatcher& aDispatcher) override {
+				if(! (mHandle.valid() && aDispatcher.cancel(*mTask))) return false;
+				// The task will never complete, so there is nothing left to wait for
+				mHandle = task_handle<T>();
+				return true;
 			}
 		};
 
 		std::vector<std::shared_ptr<task_wrapper>> mWrappers;
+		task_dispatcher* mDispatcher;	//!< The dispatcher that the tasks were last scheduled with, it executes tasks while the group waits.
 
-		std::future_status wait_for_ms(std::chrono::milliseconds);
+		std::future_status wait_for_ns(std::chrono::nanoseconds);
 		std::future_status wait_until_ms(std::chrono::milliseconds);
 	public:
+		task_group();
 		~task_group();
 
 		void wait();
 		void schedule(task_dispatcher&, task_dispatcher::priority aPriority = task_dispatcher::priority::PRIORITY_MEDIUM);
 
+		/*!
+			\brief Cancel every task in the group that is still queued.
+			\detail Cancelled tasks are not waited for, tasks that have already started are unaffected.
+			\return The number of tasks that were cancelled.
+		*/
+		size_t cancel();
+
+		/*!
+			\brief Block until every task in the group has completed or a timeout expires.
+			\detail Like wait, other scheduled tasks are executed on the calling thread in the meantime.
+			\param aPeriod The longest time to wait for.
+			\return std::future_status::ready or std::future_status::timeout.
+		*/
 		template<class R, class P>
 		inline std::future_status wait_for(const std::chrono::duration<R,P>& aPeriod) {
-			return wait_for_ms(std::chrono::duration_cast<std::chrono::milliseconds,R,P>(aPeriod));
+			return wait_for_ns(std::chrono::duration_cast<std::chrono::nanoseconds,R,P>(aPeriod));
 		}
 
 		template<class R, class P>
 		inline std::future_status wait_until(const std::chrono::duration<R,P>& aPeriod) {
-			return wait_until(std::chrono::duration_cast<std::chrono::milliseconds,R,P>(aPeriod));
+			return wait_until_ms(std::chrono::duration_cast<std::chrono::milliseconds,R,P>(aPeriod));
 		}
 
 		template<class T>
 		void add(task_dispatcher::task_ptr aTask, T* aReturn = nullptr) {
-			std::shared_ptr<task_wrapper_2<T>> task(new task_wrapper_2<T>(aTask));
+			const std::shared_ptr<as::task<T>> tmp = std::dynamic_pointer_cast<as::task<T>>(aTask);
+			if(! tmp) throw std::invalid_argument("as::task_group::add : Task does not return the requested type");
+			std::shared_ptr<task_wrapper_2<T>> task(new task_wrapper_2<T>(tmp));
 			task->set_return(aReturn);
 			mWrappers.push_back(task);
 		}
 	};
+
+	template<>
+	class task_group::task_wrapper_2<void> : public task_group::task_wrapper {
+	private:
+		std::shared_ptr<task<void>> mTask;
+		task_handle<void> mHandle;
+	public:
+		task_wrapper_2(std::shared_ptr<task<void>> aTask) :
+			mTask(aTask)
+		{}
+
+		// Inherited from task_wrapper
+
+		bool is_ready() const override {
+			return ! mHandle.valid() || mHandle.is_ready();
+		}
+
+		void wait(task_dispatcher* aDispatcher) override {
+			if(! mHandle.valid()) return;
+			if(aDispatcher) aDispatcher->wait(mHandle);
+			else mHandle.wait();
+		}
+
+		std::future_status wait_for(task_dispatcher* aDispatcher, std::chrono::nanoseconds aDuration) override {
+			if(! mHandle.valid()) return std::future_status::ready;
+			return aDispatcher ? aDispatcher->wait_for(mHandle, aDuration) : mHandle.wait_for(aDuration);
+		}
+
+		void set_return(void*) override {}
+
+		task_dispatcher::task_ptr prepare_schedule() override {
+			mHandle = task_handle<void>(mTask);
+			return mTask;
+		}
+
+		task_dispatcher::task_ptr get_scheduled_task() const override {
+			return mHandle.valid() ? mTask : nullptr;
+		}
+
+		bool cancel(task_dispatcher& aDispatcher) override {
+			if(! (mHandle.valid() && aDispatcher.cancel(*mTask))) return false;
+			mHandle = task_handle<void>();
+			return true;
+		}
+	};
 }
 
 #endif
\ No newline at end of file
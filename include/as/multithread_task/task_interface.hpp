@@ -15,17 +15,53 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <exception>
 #include <cstdint>
 #include <memory>
 
 namespace as {
+	class task_controller;
+	class task_dispatcher;
+
 	namespace implementation {
 		enum task_priority : uint8_t {
 			PRIORITY_LOW = 0,
 			PRIORITY_HIGH = 5,
 			PRIORITY_MEDIUM = PRIORITY_HIGH / 2
 		};
+
+		enum {
+			CACHE_LINE_SIZE = 64	//!< The assumed size of a cache line in bytes.
+		};
+
+		/*!
+			\brief Receives a notification when a task completes.
+			\date 18th October 2026
+			\author Adam Smith
+		*/
+		class task_continuation {
+		public:
+			task_continuation* mNext;	//!< The next continuation of the same task.
+
+			task_continuation() :
+				mNext(nullptr)
+			{}
+
+			virtual ~task_continuation() {}
+
+			/*!
+				\brief Called on the thread that executed the task, after its return value or exception has been set.
+			*/
+			virtual void on_complete() throw() = 0;
+
+			/*!
+				\brief Called on the thread that cancelled the task while it was waiting to be executed.
+				\detail The continuation stays registered, so on_complete is still called if the task is scheduled again and completes.
+				The default implementation does nothing.
+			*/
+			virtual void on_cancel() throw() {}
+		};
 	}
 
 	/*!
@@ -37,6 +73,7 @@ namespace as {
 	public:
 		friend class task_controller;
 		friend class task_dispatcher;
+		friend class task_graph;
 
 		enum state {				//!< Describes the current execution state of the task.
 			STATE_INITIALISED,		//!< The task has been initialised and is waiting to be executed.
@@ -45,9 +82,18 @@ namespace as {
 			STATE_COMPLETE			//!< The task has completed its execution.
 		};
 	private:
-		state mState;				//!< The current state of the task
-		uint8_t mPauseLocation;		//!< The location at which the task was paused
-		bool mPauseRequest;			//!< Set to true if a pause is requested externally.
+		std::atomic<state> mState;			//!< The current state of the task, only the thread that executes the task changes it.
+		uint8_t mPauseLocation;				//!< The location at which the task was paused, published by the transition to STATE_PAUSED.
+		std::atomic_bool mPauseRequest;		//!< Set to true if a pause is requested externally.
+		bool mSuspendRequest;				//!< Set to true if the task will be suspended once the current execution returns.
+		std::atomic<implementation::task_continuation*> mContinuations;	//!< A list of the continuations to notify on completion.
+		int64_t mScheduleTime;		//!< When the task was last queued by a dispatcher in steady_clock nanoseconds, or 0 if it is not recorded.
+		implementation::task_priority mPriority;	//!< The priority the task was last scheduled with.
+		std::atomic<uint32_t> mQueueTicket;			//!< Identifies the current queue entry of the task, see task_dispatcher::enqueue_ticket.
+		std::atomic<task_dispatcher*> mQueueOwner;	//!< The dispatcher that last queued the task.
+
+		void notify_continuations() throw();
+		void notify_cancelled() throw();
 	protected:
 		/*!
 			\brief Called when the task is being executed.
@@ -93,6 +139,33 @@ namespace as {
 		*/
 		bool pause(task_controller&, uint8_t) throw();
 
+		/*!
+			\brief Suspend the current task without rescheduling it.
+			\detail Once the current execution has returned the task is paused and on_suspended is called,
+			the task is not executed again until it is scheduled with a dispatcher.
+			The calling function should immediately return after this call.
+			\return True if the task will be suspended.
+			\see on_suspended
+		*/
+		bool suspend() throw();
+
+		/*!
+			\brief Called after the task has been suspended and its execution has returned.
+			\detail This is the first point at which it is safe for the task to be scheduled again,
+			another thread may execute it as soon as it has been scheduled. The default implementation does nothing.
+			\see suspend
+		*/
+		virtual void on_suspended() throw();
+
+		/*!
+			\brief Notify a continuation once a task completes.
+			\detail The continuations of a task are discarded when it is reinitialised.
+			\param aTask The task.
+			\param aContinuation The continuation, it must not already be waiting on another task.
+			\return False if the task has already completed, in which case the continuation will not be notified.
+		*/
+		static bool add_continuation(task_interface&, implementation::task_continuation&) throw();
+
 		/*!
 			\brief Cancel a task that is queued but not yet executing.
 			\param aController The controller for the dispatcher responsible for the current execution.
@@ -114,6 +187,13 @@ namespace as {
 			\return True if a pause has been requested.
 		*/
 		bool is_pause_requested() const throw();
+
+		/*!
+			\brief Return the priority the task was last scheduled with.
+			\detail A task that schedules itself again rather than pausing can use this to keep its priority.
+			\return The priority, or PRIORITY_MEDIUM if the dispatcher does not record it.
+		*/
+		implementation::task_priority get_scheduled_priority() const throw();
 	public:
 		/*!
 			\brief Create a new task.
@@ -127,6 +207,7 @@ namespace as {
 
 		/*!
 			\brief Return the current state of this task.
+			\detail This is wait-free and may be called from any thread.
 			\return The state.
 		*/
 		state get_state() const;
@@ -139,6 +220,7 @@ namespace as {
 
 		/*!
 			\brief Start or resume execution of this task.
+			\detail Does nothing unless the task is initialised or paused, so a task is never executed by two threads at once.
 			\param aController The controller for the dispatcher responsible for the current execution.
 		*/
 		void execute(task_controller&) throw();
@@ -146,10 +228,11 @@ namespace as {
 		/*!
 			\brief Reset a completed task to it's initialised state, allowing it to be executed again.
 		*/
-		bool reinitialise();
+		bool reinitialise() throw();
 
 		/*!
 			\brief Request that the task pauses itself.
+			\detail This is wait-free and may be called from any thread, it has no effect unless the task is executing.
 		*/
 		void request_pause() throw();
 	};
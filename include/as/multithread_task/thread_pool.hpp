@@ -15,12 +15,17 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
 #include <vector>
 #include <deque>
 #include <thread>
-#include <condition_variable>
 #include "task_dispatcher.hpp"
+#include "mpmc_queue.hpp"
+#include "latency_histogram.hpp"
+#include "timer_wheel.hpp"
 
 namespace as {
 
@@ -30,26 +35,357 @@ namespace as {
 		\author Adam Smith
 	*/
 	class thread_pool : public task_dispatcher {
+	public:
+		enum scheduler {				//!< Describes how scheduled tasks are distributed between worker threads.
+			SCHEDULER_SHARED_QUEUE,		//!< All workers pop tasks from a single set of priority queues.
+			SCHEDULER_WORK_STEALING		//!< Each worker owns a set of priority queues and steals from other workers when idle.
+		};
+
+		enum queue_backend {			//!< Describes how tasks scheduled from outside of the pool are queued.
+			QUEUE_LOCKED,				//!< A mutex guarded deque for each priority.
+			QUEUE_LOCK_FREE				//!< A bounded lock-free ring buffer for each priority, overflowing into the mutex guarded deque when full.
+		};
+
+		/*!
+			\brief A snapshot of the counters of a single worker.
+		*/
+		struct worker_metrics {
+			uint64_t mTasksExecuted;				//!< The number of task executions, a task that pauses is counted each time it resumes.
+			uint64_t mTasksStolen;					//!< The number of tasks taken from the queue of another worker.
+			uint64_t mPauses;						//!< The number of times a task executed by this worker paused.
+			uint64_t mCancels;						//!< The number of tasks cancelled by tasks executed by this worker.
+			uint64_t mReschedules;					//!< The number of tasks rescheduled by tasks executed by this worker.
+			std::chrono::nanoseconds mBusyTime;		//!< The time spent executing tasks.
+			std::chrono::nanoseconds mIdleTime;		//!< The time spent looking for tasks, including mParkedTime.
+			std::chrono::nanoseconds mParkedTime;	//!< The time spent blocked until a task is scheduled.
+		};
+
+		/*!
+			\brief A snapshot of the state of the pool.
+			\detail Times and histograms are only recorded while timing metrics are enabled.
+		*/
+		struct metrics {
+			size_t mQueueDepth[priority::PRIORITY_HIGH + 1];	//!< The number of tasks queued at each priority, including paused tasks.
+			size_t mTimers;										//!< The number of tasks waiting for a timer, including periodic tasks.
+			size_t mThreads;									//!< The number of worker threads that are running.
+			std::vector<worker_metrics> mWorkers;				//!< The counters of each worker, including workers whose thread has retired.
+			worker_metrics mExternal;							//!< The counters of threads outside of the pool that executed tasks through execute_scheduled_task.
+			latency_histogram mScheduleToStart;					//!< The time between a task being queued and starting to execute.
+			latency_histogram mRunTime;							//!< The time taken by each task execution.
+		};
 	private:
-		std::condition_variable mTaskScheduled;						//!< Notifies when a task is scheduled or the pool is being deleted.
-		std::vector<std::thread> mThreads;							//!< The worker threads.
-		std::deque<task_ptr> mTasks[priority::PRIORITY_HIGH + 1];	//!< The tasks that are scheduled.
+		class controller;
+
+		/*!
+			\brief A task in one of the queues.
+			\detail The entry is stale, and is discarded when it is reached, once its ticket no longer matches the task.
+		*/
+		struct queue_entry {
+			task_ptr mTask;		//!< The queued task.
+			uint32_t mTicket;	//!< Identifies this entry, see task_dispatcher::enqueue_ticket.
+		};
+
+		/*!
+			\brief The metrics recorded by a single worker.
+			\detail Each set is on its own cache lines so that recording does not contend with other workers.
+		*/
+		struct alignas(implementation::CACHE_LINE_SIZE) counters {
+			std::atomic<uint64_t> mTasksExecuted;
+			std::atomic<uint64_t> mTasksStolen;
+			std::atomic<uint64_t> mPauses;
+			std::atomic<uint64_t> mCancels;
+			std::atomic<uint64_t> mReschedules;
+			std::atomic<uint64_t> mBusyTime;
+			std::atomic<uint64_t> mIdleTime;
+			std::atomic<uint64_t> mParkedTime;
+			implementation::atomic_histogram mScheduleToStart;
+			implementation::atomic_histogram mRunTime;
+
+			counters();
+
+			static void add(std::atomic<uint64_t>&, uint64_t) throw();
+			void copy_to(worker_metrics&) const throw();
+		};
+
+		/*!
+			\brief The state owned by a single worker thread.
+		*/
+		struct worker {
+			std::deque<queue_entry> mTasks[priority::PRIORITY_HIGH + 1];	//!< Tasks scheduled from inside a task running on this worker (SCHEDULER_WORK_STEALING only).
+			std::mutex mTasksLock;										//!< Thread-safe access to mTasks.
+			std::thread mThread;										//!< The worker thread, started on demand.
+			std::atomic_bool mRunning;									//!< True from when the thread is started until it has stopped using the worker.
+			thread_pool& mPool;											//!< The pool that owns this worker.
+			const size_t mIndex;										//!< The position of this worker in thread_pool::mWorkers.
+			counters mCounters;											//!< The metrics recorded by this worker.
+
+			worker(thread_pool&, size_t);
+		};
+
+		static thread_local worker* tCurrentWorker;					//!< The worker running on the calling thread, or nullptr if it is not a worker thread.
+
+		std::atomic<uint32_t> mWakeEpoch;							//!< Incremented to wake parked workers when a task is scheduled or the pool is being deleted.
+		std::atomic<uint32_t> mSleepers;							//!< The number of workers that are parked, or about to park, on mWakeEpoch.
+		std::atomic<int64_t> mSpinDuration;							//!< The number of nanoseconds an idle worker looks for tasks before parking.
+		std::vector<std::unique_ptr<worker>> mWorkers;				//!< A worker for each thread that may be running.
+		std::mutex mWorkersLock;									//!< Serialises starting worker threads with each other and with the destructor.
+		std::atomic_size_t mThreadCount;							//!< The number of workers with a running thread.
+		std::atomic<uint32_t> mIdleWorkers;							//!< The number of workers that are looking for a task or parked.
+		const size_t mMinThreads;									//!< Workers do not retire below this number of threads.
+		std::atomic<int64_t> mIdleTimeout;							//!< The number of nanoseconds a parked worker waits before it retires.
+		std::atomic_bool mMonitoring;								//!< Set while the timer thread is watching for tasks that no worker is free to execute.
+		int64_t mBacklogSince;										//!< When the current backlog was first seen, in steady_clock nanoseconds, protected by mTimerLock.
+		int64_t mNextMonitor;										//!< When the backlog is next checked, in steady_clock nanoseconds, protected by mTimerLock.
+		std::deque<queue_entry> mTasks[priority::PRIORITY_HIGH + 1];	//!< The tasks that are scheduled from outside of the pool.
+		std::unique_ptr<mpmc_queue<queue_entry>> mLockFreeTasks[priority::PRIORITY_HIGH + 1];	//!< The tasks that are scheduled from outside of the pool (QUEUE_LOCK_FREE only).
 		std::mutex mTasksLock;										//!< Thread-safe access to mTasks.
-		priority mHighPriority;										//!< The highest priority rating that is currently scheduled.
-		bool mExit;													//!< Set to true when the destructor is called.
+		std::atomic_size_t mTaskSizes[priority::PRIORITY_HIGH + 1];	//!< The size of each queue in mTasks, so that an empty queue is skipped without locking mTasksLock.
+		std::atomic_size_t mTaskCount[priority::PRIORITY_HIGH + 1];	//!< The number of tasks queued at each priority, across all queues.
+		std::atomic<uint32_t> mPriorityMask;						//!< Bit i is set while mTaskCount[i] may be non-zero.
+		std::atomic<int64_t> mAgingThreshold;						//!< The number of nanoseconds a task waits before it is promoted, or 0 if aging is disabled.
+		std::atomic<int64_t> mNextAging;							//!< When tasks should next be checked for promotion, in steady_clock nanoseconds.
+		std::atomic_size_t mStaleTasks;								//!< The number of stale entries that are still in the queues.
+		std::atomic_size_t mNextPurge;								//!< The number of stale entries at which they are next purged.
+		std::atomic_bool mPurging;									//!< True while a thread is removing stale entries.
+		const scheduler mScheduler;									//!< How tasks are distributed between the workers.
+		const queue_backend mQueueBackend;							//!< How tasks scheduled from outside of the pool are queued.
+		std::atomic_bool mExit;										//!< Set to true when the destructor is called.
+		std::atomic_bool mTimingMetrics;							//!< True if execution times are recorded.
+		counters mExternalCounters;									//!< The metrics recorded by threads outside of the pool.
+		implementation::timer_wheel mTimers;						//!< The tasks that are scheduled after a delay.
+		std::mutex mTimerLock;										//!< Thread-safe access to mTimers.
+		std::condition_variable mTimerCondition;					//!< Wakes the timer thread when a timer is added or the pool is being deleted.
+		std::thread mTimerThread;									//!< Schedules tasks when their timers expire, started when the first timer is added.
+		std::atomic_size_t mTimerCount;								//!< The number of timers in mTimers.
 	private:
+		/*!
+			\brief Create the workers, their threads are started on demand.
+			\param aThreads The maximum number of worker threads.
+			\param aQueueCapacity The capacity of each lock-free queue (QUEUE_LOCK_FREE only).
+		*/
+		void create_workers(size_t, size_t);
+
+		/*!
+			\brief Start the thread of a worker that is not running.
+			\return False if the maximum number of threads are already running, or the thread could not be created.
+		*/
+		bool start_worker() throw();
+
+		/*!
+			\brief Start worker threads if tasks have been scheduled and no worker is free to execute them.
+			\detail Threads are started straight away until the minimum is reached. Beyond that, if every worker is busy, the timer
+			thread is asked to monitor the backlog, see monitor.
+			\param aCount The number of tasks that were scheduled.
+		*/
+		void add_workers(size_t) throw();
+
+		/*!
+			\brief Check whether tasks are still waiting with every worker busy, and add compensating threads if they have been for too long.
+			\detail Called by the timer thread with mTimerLock held, several times per MONITOR_INTERVAL while mMonitoring is set.
+			Once tasks have been queued with no idle worker for a whole interval, which happens when the workers are blocked rather than
+			working through a short burst, a thread is started for each queued task up to the maximum. Monitoring stops as soon as a
+			worker is idle or the queues are empty.
+			\param aNow The current time in steady_clock nanoseconds.
+		*/
+		void monitor(int64_t) throw();
+
+		/*!
+			\brief Stop a worker whose thread has been idle for the idle timeout.
+			\detail Tasks left in the local queues of the worker are moved to the queue for tasks that are scheduled from outside of the pool.
+			\param aWorker The worker that is running on the calling thread.
+			\return False if the worker must keep running because the pool is at its minimum number of threads.
+		*/
+		bool retire_worker(worker&);
+
+		/*!
+			\brief Add a task to the queue for tasks that are scheduled from outside of the pool.
+			\param aTask The task to add.
+			\param aPriority The priority to schedule the task with.
+		*/
+		void push_injected_task(task_ptr, priority);
+
+		/*!
+			\brief Add several tasks to the queue for tasks that are scheduled from outside of the pool.
+			\detail The tasks are added with a single lock, or a single reservation in a lock-free queue.
+			\param aTasks The tasks to add.
+			\param aCount The number of tasks.
+			\param aPriority The priority to schedule the tasks with.
+		*/
+		void push_injected_tasks(const task_ptr*, size_t, priority);
+
+		/*!
+			\brief Remove a task that is ready to execute from the queue for tasks that are scheduled from outside of the pool.
+			\param aPriority The priority to remove a task from.
+			\return The task, or an empty pointer if no tasks are ready.
+		*/
+		task_ptr pop_injected_task(priority);
+
+		/*!
+			\brief Publish the size of each queue in mTasks to mTaskSizes.
+			\detail mTasksLock must be held by the caller, after it has changed mTasks.
+		*/
+		void update_task_sizes() throw();
+
+		/*!
+			\brief Count tasks that have been added to a queue.
+			\param aPriority The priority of the queue.
+			\param aCount The number of tasks.
+		*/
+		void add_task_count(priority, size_t aCount = 1) throw();
+
+		/*!
+			\brief Stop counting a task that has been removed from a queue.
+			\param aPriority The priority of the queue.
+		*/
+		void remove_task_count(priority) throw();
+
+		/*!
+			\brief Clear the bit of a priority in mPriorityMask, unless a task was counted at that priority in the meantime.
+			\param aPriority The priority.
+		*/
+		void clear_priority(priority) throw();
+
+		/*!
+			\brief Take a task out of the queues without executing it.
+			\detail The entry of the task is left in its queue, where it is discarded once it is reached.
+			\param aTask The task.
+			\return False if the task is not queued by this pool.
+		*/
+		bool remove_task(task_interface&) throw();
+
+		/*!
+			\brief Count an entry that has been left in a queue after its task was cancelled or rescheduled.
+			\detail Once stale entries outnumber the queued tasks they are removed from the locked queues, so that the
+			memory of cancelled tasks is released even if no worker reaches their entries.
+		*/
+		void add_stale_task();
+
+		/*!
+			\brief Remove the stale entries from a set of priority queues.
+			\detail The lock that guards aQueues must be held by the caller.
+			\param aQueues The queue of each priority.
+		*/
+		void purge_queues(std::deque<queue_entry>*) throw();
+
+		/*!
+			\brief Promote tasks that have waited longer than the aging threshold.
+			\detail Only one thread promotes tasks at a time, and at most four times per threshold.
+		*/
+		void age_tasks();
+
+		/*!
+			\brief Promote tasks from the front of a set of priority queues.
+			\detail A task is raised by one priority for each threshold it has waited since it was scheduled.
+			The lock that guards aQueues must be held by the caller.
+			\param aQueues The queue of each priority.
+			\param aNow The current time in steady_clock nanoseconds.
+			\param aThreshold The aging threshold in nanoseconds.
+			\param aFront True if tasks are taken from the front of aQueues, false if they are taken from the back.
+		*/
+		void age_queues(std::deque<queue_entry>*, int64_t, int64_t, bool);
+
+		/*!
+			\brief Add a task to the end of a queue.
+			\detail The task is marked as queued at aPriority. The lock that guards aQueue must be held by the caller.
+			\param aQueue The queue to add the task to.
+			\param aTask The task to add.
+			\param aPriority The priority of aQueue.
+		*/
+		void push_task(std::deque<queue_entry>&, task_ptr, priority);
+
+		/*!
+			\brief Remove a task that is ready to execute from a queue.
+			\detail Paused tasks that should not yet resume are skipped, and stale entries are discarded.
+			The lock that guards aQueue must be held by the caller.
+			\param aQueue The queue to remove the task from.
+			\param aPriority The priority of aQueue.
+			\param aBack True if the task should be taken from the back of the queue rather than the front.
+			\return The task, or an empty pointer if aQueue contains no task that is ready.
+		*/
+		task_ptr pop_task(std::deque<queue_entry>&, priority, bool);
+
+		/*!
+			\brief Remove the next task that a thread should execute.
+			\param aWorker The worker that will execute the task, or nullptr if it will be executed by a thread outside of the pool.
+			\return The task, or an empty pointer if no tasks are ready.
+		*/
+		task_ptr pop_task(worker*);
+
+		/*!
+			\brief Check if any queue in the pool contains a task.
+			\detail The result includes paused tasks that are not ready to resume.
+			\return True if a task is queued.
+		*/
+		bool has_tasks() const throw();
+
+		/*!
+			\brief Wait until a task may be available.
+			\detail Spins then yields for the spin duration before parking the calling worker.
+			\param aWorker The worker that is running on the calling thread.
+			\param aExpired Set to true if the worker was parked for the whole idle timeout.
+			\return A task that was found while spinning, or an empty pointer if the worker parked.
+		*/
+		task_ptr idle(worker&, bool&);
+
+		/*!
+			\brief Wake parked workers, if there are any, or start more worker threads if there are not.
+			\param aCount The maximum number of workers to wake.
+		*/
+		void wake_workers(size_t) throw();
+
+		/*!
+			\brief Return the metrics that a thread should record to.
+			\param aWorker The worker running on the calling thread, or nullptr if it is not a worker thread.
+			\return The counters.
+		*/
+		counters& get_counters(worker*) throw();
+
+		/*!
+			\brief Execute a task and record its metrics.
+			\param aTask The task to execute.
+			\param aController The controller for the calling thread.
+			\param aCounters The metrics of the calling thread.
+		*/
+		void execute_task(task_interface&, task_controller&, counters&);
+
+		/*!
+			\brief Add a timer that schedules a task.
+			\detail The timer thread is started if it is not already running.
+			\param aTask The task.
+			\param aDeadline When the task is first scheduled, in steady_clock nanoseconds.
+			\param aPeriod The number of nanoseconds between schedules, or 0 if the task is only scheduled once.
+			\param aPriority The priority to schedule the task with.
+		*/
+		void add_timer(task_ptr, int64_t, int64_t, priority);
+
+		/*!
+			\brief Remove the timer of a task.
+			\param aTask The task.
+			\return False if the task does not have a timer.
+		*/
+		bool remove_timer(const task_interface&) throw();
+
+		/*!
+			\brief The timer loop.
+			\detail Sleeps until the next timer expires, then schedules the expired tasks. Also runs monitor while it is needed.
+		*/
+		void timer_function();
+
 		/*!
 			\brief The task dispatch and execution loop.
 			\detail Called once on each worker thread.
+			\param aWorker The worker that is running on the calling thread.
 		*/
-		void worker_function();
+		void worker_function(worker&);
 	protected:
 		// Inherited from task_dispatcher
 		void schedule_task(task_ptr, priority) override;
+		void schedule_tasks(const task_ptr*, size_t, priority) override;
 	public:
 		/*!
 			\brief Create a new thread_pool.
 			\detail The number of worker threads will be equal to the reported hardware capability.
+			Worker threads are started as tasks are scheduled rather than all at once.
 		*/
 		thread_pool();
 
@@ -59,11 +395,170 @@ namespace as {
 		*/
 		thread_pool(size_t);
 
+		/*!
+			\brief Create a new thread_pool.
+			\param aThreads The number of worker threads.
+			\param aScheduler How tasks are distributed between the workers.
+		*/
+		thread_pool(size_t, scheduler);
+
+		/*!
+			\brief Create a new thread_pool.
+			\param aThreads The number of worker threads.
+			\param aScheduler How tasks are distributed between the workers.
+			\param aQueueBackend How tasks scheduled from outside of the pool are queued.
+			\param aQueueCapacity The number of tasks each priority level can hold before scheduling falls back to the locked queue (QUEUE_LOCK_FREE only).
+		*/
+		thread_pool(size_t, scheduler, queue_backend, size_t aQueueCapacity = 4096);
+
+		/*!
+			\brief Create a new thread_pool whose number of threads changes with load.
+			\detail No threads are started until tasks are scheduled. Threads are then started on demand up to aMinThreads, and once
+			tasks have waited for 10 milliseconds with every worker busy, for example because tasks are blocked on I/O, compensating
+			threads are added for the waiting tasks up to aMaxThreads. Threads above aMinThreads retire once they have been idle for the
+			idle timeout.
+			\param aMinThreads The number of threads that are kept once they have started.
+			\param aMaxThreads The maximum number of threads.
+			\param aScheduler How tasks are distributed between the workers.
+			\param aQueueBackend How tasks scheduled from outside of the pool are queued.
+			\param aQueueCapacity The number of tasks each priority level can hold before scheduling falls back to the locked queue (QUEUE_LOCK_FREE only).
+		*/
+		thread_pool(size_t, size_t, scheduler aScheduler = SCHEDULER_SHARED_QUEUE, queue_backend aQueueBackend = QUEUE_LOCKED, size_t aQueueCapacity = 4096);
+
 		/*!
 			\brief Destroy the pool and join the worker threads.
 			\detail Any still scheduled tasks will not be executed.
 		*/
 		~thread_pool();
+
+		/*!
+			\brief Return the number of threads that are kept once they have started.
+			\return The minimum number of threads.
+		*/
+		size_t get_min_threads() const throw();
+
+		/*!
+			\brief Return the maximum number of worker threads.
+			\return The maximum number of threads.
+		*/
+		size_t get_max_threads() const throw();
+
+		/*!
+			\brief Return the number of worker threads that are currently running.
+			\return The number of threads.
+		*/
+		size_t get_thread_count() const throw();
+
+		/*!
+			\brief Set how long a worker thread above the minimum stays parked before it retires.
+			\param aTimeout The timeout, the default is 10 seconds.
+		*/
+		void set_idle_timeout(std::chrono::nanoseconds) throw();
+
+		/*!
+			\brief Return how long a worker thread above the minimum stays parked before it retires.
+			\return The timeout.
+		*/
+		std::chrono::nanoseconds get_idle_timeout() const throw();
+
+		/*!
+			\brief Return how tasks are distributed between the workers.
+			\return The scheduler.
+		*/
+		scheduler get_scheduler() const throw();
+
+		/*!
+			\brief Return how tasks scheduled from outside of the pool are queued.
+			\return The queue backend.
+		*/
+		queue_backend get_queue_backend() const throw();
+
+		/*!
+			\brief Set how long an idle worker keeps looking for tasks before it parks.
+			\detail Spinning lowers the latency of tasks scheduled shortly after a worker runs out of work,
+			at the cost of CPU time while the pool is idle. A duration of zero parks immediately.
+			\param aDuration The duration, the default is 50 microseconds.
+		*/
+		void set_spin_duration(std::chrono::nanoseconds) throw();
+
+		/*!
+			\brief Return how long an idle worker keeps looking for tasks before it parks.
+			\return The duration.
+		*/
+		std::chrono::nanoseconds get_spin_duration() const throw();
+
+		/*!
+			\brief Enable or disable the recording of busy, idle and parked times and latency histograms.
+			\detail Counters are always recorded. Timing costs a few clock reads per task and is enabled by default.
+			\param aEnabled True if timing metrics should be recorded.
+		*/
+		void set_timing_metrics(bool) throw();
+
+		/*!
+			\brief Check if busy, idle and parked times and latency histograms are recorded.
+			\return True if timing metrics are enabled.
+		*/
+		bool get_timing_metrics() const throw();
+
+		/*!
+			\brief Set how long a task may wait before it is promoted to a higher priority.
+			\detail Without aging, low priority tasks are never executed while higher priority tasks keep being scheduled.
+			A task is raised by one priority for each threshold it has waited, but it is still queued again at the priority
+			it was scheduled with if it pauses. Tasks that are still in a lock-free queue (QUEUE_LOCK_FREE) are not promoted.
+			\param aThreshold The threshold, or zero to disable aging. Aging is disabled by default.
+		*/
+		void set_aging_threshold(std::chrono::nanoseconds) throw();
+
+		/*!
+			\brief Return how long a task may wait before it is promoted to a higher priority.
+			\return The threshold, or zero if aging is disabled.
+		*/
+		std::chrono::nanoseconds get_aging_threshold() const throw();
+
+		/*!
+			\brief Schedule a task once a delay has passed.
+			\detail Timers are kept in a hierarchical timer wheel with a resolution of 1 millisecond, which is serviced by a single
+			timer thread. A task is never scheduled early, but may be scheduled up to one resolution late. Adding a timer for a task
+			that already has one replaces it, and cancel removes it.
+			\param aTask The task to schedule.
+			\param aDelay How long to wait before scheduling the task.
+			\param aPriority The priority to schedule the task with.
+		*/
+		void schedule_after(task_ptr, std::chrono::nanoseconds, priority aPriority = priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Schedule a task at a point in time.
+			\param aTask The task to schedule.
+			\param aTime When to schedule the task.
+			\param aPriority The priority to schedule the task with.
+			\see schedule_after
+		*/
+		void schedule_at(task_ptr, std::chrono::steady_clock::time_point, priority aPriority = priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Schedule a task repeatedly.
+			\detail The task is first scheduled one period from now. Each time its timer expires a completed task is reinitialised
+			and scheduled again, so the same task object is reused for every period. A period is skipped if the task is still
+			queued or executing from the previous one. The task is scheduled until it is cancelled, cancelling a task while it
+			is executing stops the periods that follow.
+			\param aTask The task to schedule.
+			\param aPeriod The time between the task being scheduled.
+			\param aPriority The priority to schedule the task with.
+			\throw std::invalid_argument If aPeriod is not positive.
+		*/
+		void schedule_every(task_ptr, std::chrono::nanoseconds, priority aPriority = priority::PRIORITY_MEDIUM);
+
+		/*!
+			\brief Take a snapshot of the queue depths and worker counters.
+			\detail This may be called from any thread while the pool is running. Each value is read atomically,
+			but the snapshot as a whole is not, so values can be slightly out of step with each other.
+			\return The metrics.
+		*/
+		metrics get_metrics() const;
+
+		// Inherited from task_dispatcher
+		bool execute_scheduled_task() override;
+		bool cancel(task_interface&) throw() override;
 	};
 }
 
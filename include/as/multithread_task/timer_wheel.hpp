@@ -0,0 +1,151 @@
+#ifndef ASMITH_TIMER_WHEEL_HPP
+#define ASMITH_TIMER_WHEEL_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "task_interface.hpp"
+
+namespace as { namespace implementation {
+
+	/*!
+		\brief Keeps tasks until a deadline, in a hierarchical timer wheel.
+		\detail Time is divided into ticks of a fixed resolution. Each level of the wheel has 64 slots, a slot of level 0 holds the
+		timers of a single tick and a slot of level n holds 64 slots of level n - 1. A timer is added to the lowest level that the
+		current tick shares a block with, and is moved down a level each time the wheel reaches the start of its slot, so adding,
+		removing and expiring a timer are all constant time. Deadlines beyond the top level wait in an overflow list.
+		A timer never expires before its deadline, but may expire up to one resolution after it.
+		The wheel is not thread-safe, the owner must guard it with a lock.
+		\date 18th October 2026
+		\author Adam Smith
+	*/
+	class timer_wheel {
+	public:
+		typedef std::shared_ptr<task_interface> task_ptr;
+
+		/*!
+			\brief A task whose timer has expired.
+		*/
+		struct expired_timer {
+			task_ptr mTask;				//!< The task.
+			task_priority mPriority;	//!< The priority to schedule the task with.
+			bool mPeriodic;				//!< True if the timer has been added again for its next period.
+		};
+	private:
+		enum : uint32_t {
+			LEVEL_BITS = 6,					//!< The number of bits of a tick that each level covers.
+			SLOT_COUNT = 1 << LEVEL_BITS,	//!< The number of slots in each level.
+			LEVEL_COUNT = 4,				//!< The number of levels, the overflow list is stored as an extra level.
+			TOP_BITS = LEVEL_BITS * LEVEL_COUNT	//!< The number of bits of a tick covered by the whole wheel.
+		};
+
+		struct timer {
+			task_ptr mTask;				//!< The task to schedule.
+			int64_t mDeadline;			//!< When the timer expires, in steady_clock nanoseconds.
+			int64_t mPeriod;			//!< The number of nanoseconds between expiries, or 0 if the timer only expires once.
+			timer* mPrevious;			//!< The previous timer in the same slot.
+			timer* mNext;				//!< The next timer in the same slot.
+			task_priority mPriority;	//!< The priority to schedule the task with.
+			uint8_t mLevel;				//!< The level that holds the timer.
+			uint8_t mSlot;				//!< The slot that holds the timer.
+		};
+
+		std::unordered_map<const task_interface*, timer> mTimers;	//!< Every timer, keyed by its task. Elements are never moved, so the slots link them directly.
+		timer* mSlots[LEVEL_COUNT + 1][SLOT_COUNT];					//!< The first timer in each slot.
+		uint64_t mOccupied[LEVEL_COUNT + 1];						//!< Bit i is set if slot i of a level holds a timer.
+		uint64_t mCurrent;											//!< The first tick that has not been processed.
+		const int64_t mOrigin;										//!< The start of tick 0, in steady_clock nanoseconds.
+		const int64_t mResolution;									//!< The number of nanoseconds in a tick.
+
+		/*!
+			\brief Add a timer to the slot that its deadline falls in.
+			\param aTimer The timer, it must not be in a slot.
+		*/
+		void link(timer&) throw();
+
+		/*!
+			\brief Remove a timer from its slot.
+			\param aTimer The timer.
+		*/
+		void unlink(timer&) throw();
+
+		/*!
+			\brief Move the timers in a slot to the slots that their deadlines fall in relative to the current tick.
+			\param aLevel The level of the slot.
+			\param aSlot The index of the slot.
+		*/
+		void cascade(uint32_t, uint32_t) throw();
+
+		/*!
+			\brief Return the next tick at which timers expire or must be moved down a level.
+			\return The tick, or UINT64_MAX if there are no timers.
+		*/
+		uint64_t get_next_tick() const throw();
+	public:
+		/*!
+			\brief Create an empty wheel.
+			\param aOrigin The start of the first tick, in steady_clock nanoseconds.
+			\param aResolution The duration of a tick.
+		*/
+		timer_wheel(int64_t, std::chrono::nanoseconds);
+
+		timer_wheel(const timer_wheel&) = delete;
+		timer_wheel& operator=(const timer_wheel&) = delete;
+
+		/*!
+			\brief Return the number of timers.
+			\return The count.
+		*/
+		size_t size() const throw();
+
+		/*!
+			\brief Add a timer for a task, replacing the task's existing timer if it has one.
+			\param aTask The task.
+			\param aDeadline When the timer first expires, in steady_clock nanoseconds.
+			\param aPeriod The number of nanoseconds between expiries, or 0 if the timer only expires once.
+			\param aPriority The priority to schedule the task with.
+			\param aNow The current time in steady_clock nanoseconds.
+		*/
+		void add(task_ptr, int64_t, int64_t, task_priority, int64_t);
+
+		/*!
+			\brief Remove the timer of a task.
+			\param aTask The task.
+			\return False if the task does not have a timer.
+		*/
+		bool remove(const task_interface&) throw();
+
+		/*!
+			\brief Return when the wheel next needs to be advanced.
+			\return The time in steady_clock nanoseconds, or INT64_MAX if there are no timers.
+		*/
+		int64_t get_next_deadline() const throw();
+
+		/*!
+			\brief Expire every timer whose deadline has passed.
+			\detail One-shot timers are removed. Periodic timers are added again at their next deadline after aNow,
+			periods that have been missed entirely are skipped rather than expiring several times at once.
+			\param aNow The current time in steady_clock nanoseconds.
+			\param aExpired The expired tasks are appended to this.
+		*/
+		void advance(int64_t, std::vector<expired_timer>&);
+	};
+}}
+
+#endif
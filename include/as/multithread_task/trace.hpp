@@ -0,0 +1,93 @@
+#ifndef ASMITH_TRACE_HPP
+#define ASMITH_TRACE_HPP
+
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+// Set to 0 when building the library to remove tracing entirely
+#ifndef ASMITH_TASK_TRACE
+	#define ASMITH_TASK_TRACE 1
+#endif
+
+namespace as {
+	class task_interface;
+
+	namespace implementation {
+		enum trace_event : uint8_t {
+			TRACE_SCHEDULE,		//!< The task was queued by a dispatcher.
+			TRACE_START,		//!< The task started executing.
+			TRACE_RESUME,		//!< The task resumed executing after being paused.
+			TRACE_PAUSE,		//!< The task paused or suspended.
+			TRACE_COMPLETE,		//!< The task completed.
+			TRACE_CANCEL		//!< The task was cancelled before it executed.
+		};
+
+		extern std::atomic_bool gTraceEnabled;	//!< True if events are being recorded.
+
+		/*!
+			\brief Record an event in the calling thread's ring buffer.
+			\param aEvent The type of event.
+			\param aTask The task that the event refers to.
+			\param aPriority The priority of the task, if it is known.
+		*/
+		void trace_record(trace_event, const task_interface*, uint8_t) throw();
+
+		/*!
+			\brief Record an event if tracing is enabled.
+			\detail Compiles to nothing when ASMITH_TASK_TRACE is 0, otherwise costs a single relaxed load while tracing is disabled.
+			\param aEvent The type of event.
+			\param aTask The task that the event refers to.
+			\param aPriority The priority of the task, if it is known.
+		*/
+		inline void trace(trace_event aEvent, const task_interface* aTask, uint8_t aPriority = 0) throw() {
+#if ASMITH_TASK_TRACE
+			if(gTraceEnabled.load(std::memory_order_relaxed)) trace_record(aEvent, aTask, aPriority);
+#endif
+		}
+	}
+
+	/*!
+		\brief Start or stop recording task events.
+		\detail Schedule, start, pause, resume, complete and cancel events are recorded into a lock-free ring buffer
+		owned by the thread that caused them. When a buffer is full the oldest events are overwritten.
+		Nothing is recorded if the library was built with ASMITH_TASK_TRACE set to 0.
+		\param aEnabled True if events should be recorded.
+	*/
+	void set_trace_enabled(bool) throw();
+
+	/*!
+		\brief Check if task events are being recorded.
+		\return True if tracing is enabled.
+	*/
+	bool is_trace_enabled() throw();
+
+	/*!
+		\brief Discard every event that has been recorded so far.
+	*/
+	void clear_trace() throw();
+
+	/*!
+		\brief Write the recorded events in the Chrome trace event format.
+		\detail The output can be opened with chrome://tracing or ui.perfetto.dev. Each thread's executions are shown as slices,
+		with flow arrows from where a task was scheduled to where it started. This may be called while events are being recorded.
+		\param aStream The stream to write to.
+	*/
+	void write_chrome_trace(std::ostream&);
+}
+
+#endif
@@ -0,0 +1,81 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/enumerable_thread_specific.hpp"
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace as { namespace implementation {
+
+	/*!
+		\brief Hands out thread slots, reusing the lowest free slot first.
+	*/
+	struct thread_slot_registry {
+		std::vector<uint32_t> mFree;	//!< A min-heap of the slots released by exited threads.
+		uint32_t mNext;					//!< The lowest slot that has never been used.
+		std::mutex mLock;
+
+		thread_slot_registry() :
+			mNext(0)
+		{}
+
+		uint32_t acquire() {
+			std::lock_guard<std::mutex> lock(mLock);
+			if(mFree.empty()) return mNext++;
+			std::pop_heap(mFree.begin(), mFree.end(), std::greater<uint32_t>());
+			const uint32_t tmp = mFree.back();
+			mFree.pop_back();
+			return tmp;
+		}
+
+		void release(uint32_t aSlot) {
+			std::lock_guard<std::mutex> lock(mLock);
+			mFree.push_back(aSlot);
+			std::push_heap(mFree.begin(), mFree.end(), std::greater<uint32_t>());
+		}
+	};
+
+	// Leaked so that threads which exit during static destruction can still release their slots
+	static thread_slot_registry& gThreadSlots = *new thread_slot_registry();
+
+	/*!
+		\brief Owns the calling thread's slot.
+	*/
+	struct thread_slot {
+		uint32_t mSlot;
+		bool mAcquired;
+
+		thread_slot() :
+			mSlot(0),
+			mAcquired(false)
+		{}
+
+		~thread_slot() {
+			if(mAcquired) gThreadSlots.release(mSlot);
+		}
+	};
+
+	static thread_local thread_slot tThreadSlot;
+
+	uint32_t get_thread_slot() {
+		thread_slot& slot = tThreadSlot;
+		if(! slot.mAcquired) {
+			slot.mSlot = gThreadSlots.acquire();
+			slot.mAcquired = true;
+		}
+		return slot.mSlot;
+	}
+}}
@@ -0,0 +1,132 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/futex.hpp"
+
+#if defined(__linux__)
+	#include <linux/futex.h>
+	#include <sys/syscall.h>
+	#include <unistd.h>
+	#include <ctime>
+	#include <climits>
+#elif defined(_WIN32)
+	#include <windows.h>
+	#pragma comment(lib, "synchronization.lib")
+#else
+	#include <mutex>
+	#include <condition_variable>
+#endif
+
+namespace as { namespace implementation {
+#if defined(__linux__)
+
+	static void futex_call(const std::atomic<uint32_t>& aValue, int aOperation, uint32_t aArgument, const timespec* aTimeout) throw() {
+		syscall(SYS_futex, const_cast<std::atomic<uint32_t>*>(&aValue), aOperation | FUTEX_PRIVATE_FLAG, aArgument, aTimeout, nullptr, 0);
+	}
+
+	void futex_wait(const std::atomic<uint32_t>& aValue, uint32_t aExpected) throw() {
+		futex_call(aValue, FUTEX_WAIT, aExpected, nullptr);
+	}
+
+	void futex_wait_for(const std::atomic<uint32_t>& aValue, uint32_t aExpected, std::chrono::nanoseconds aTimeout) throw() {
+		if(aTimeout.count() <= 0) return;
+		timespec timeout;
+		timeout.tv_sec = static_cast<time_t>(aTimeout.count() / 1000000000);
+		timeout.tv_nsec = static_cast<long>(aTimeout.count() % 1000000000);
+		futex_call(aValue, FUTEX_WAIT, aExpected, &timeout);
+	}
+
+	void futex_wake_one(const std::atomic<uint32_t>& aValue) throw() {
+		futex_call(aValue, FUTEX_WAKE, 1, nullptr);
+	}
+
+	void futex_wake(const std::atomic<uint32_t>& aValue, uint32_t aCount) throw() {
+		futex_call(aValue, FUTEX_WAKE, aCount > INT_MAX ? INT_MAX : aCount, nullptr);
+	}
+
+	void futex_wake_all(const std::atomic<uint32_t>& aValue) throw() {
+		futex_call(aValue, FUTEX_WAKE, INT_MAX, nullptr);
+	}
+
+#elif defined(_WIN32)
+
+	void futex_wait(const std::atomic<uint32_t>& aValue, uint32_t aExpected) throw() {
+		WaitOnAddress(const_cast<std::atomic<uint32_t>*>(&aValue), &aExpected, sizeof(uint32_t), INFINITE);
+	}
+
+	void futex_wait_for(const std::atomic<uint32_t>& aValue, uint32_t aExpected, std::chrono::nanoseconds aTimeout) throw() {
+		if(aTimeout.count() <= 0) return;
+		const DWORD ms = static_cast<DWORD>(std::chrono::duration_cast<std::chrono::milliseconds>(aTimeout + std::chrono::nanoseconds(999999)).count());
+		WaitOnAddress(const_cast<std::atomic<uint32_t>*>(&aValue), &aExpected, sizeof(uint32_t), ms);
+	}
+
+	void futex_wake_one(const std::atomic<uint32_t>& aValue) throw() {
+		WakeByAddressSingle(const_cast<std::atomic<uint32_t>*>(&aValue));
+	}
+
+	void futex_wake(const std::atomic<uint32_t>& aValue, uint32_t aCount) throw() {
+		for(uint32_t i = 0; i < aCount; ++i) WakeByAddressSingle(const_cast<std::atomic<uint32_t>*>(&aValue));
+	}
+
+	void futex_wake_all(const std::atomic<uint32_t>& aValue) throw() {
+		WakeByAddressAll(const_cast<std::atomic<uint32_t>*>(&aValue));
+	}
+
+#else
+
+	// Addresses are hashed onto a fixed set of condition variables, a wake notifies every thread on the same bucket
+	struct bucket {
+		std::mutex mLock;
+		std::condition_variable mCondition;
+	};
+
+	enum {
+		BUCKET_COUNT = 64
+	};
+
+	static bucket& get_bucket(const std::atomic<uint32_t>& aValue) throw() {
+		static bucket gBuckets[BUCKET_COUNT];
+		return gBuckets[(reinterpret_cast<uintptr_t>(&aValue) >> 4) % BUCKET_COUNT];
+	}
+
+	void futex_wait(const std::atomic<uint32_t>& aValue, uint32_t aExpected) throw() {
+		bucket& b = get_bucket(aValue);
+		std::unique_lock<std::mutex> lock(b.mLock);
+		if(aValue.load() == aExpected) b.mCondition.wait(lock);
+	}
+
+	void futex_wait_for(const std::atomic<uint32_t>& aValue, uint32_t aExpected, std::chrono::nanoseconds aTimeout) throw() {
+		bucket& b = get_bucket(aValue);
+		std::unique_lock<std::mutex> lock(b.mLock);
+		if(aValue.load() == aExpected) b.mCondition.wait_for(lock, aTimeout);
+	}
+
+	void futex_wake_one(const std::atomic<uint32_t>& aValue) throw() {
+		futex_wake_all(aValue);
+	}
+
+	void futex_wake(const std::atomic<uint32_t>& aValue, uint32_t) throw() {
+		futex_wake_all(aValue);
+	}
+
+	void futex_wake_all(const std::atomic<uint32_t>& aValue) throw() {
+		bucket& b = get_bucket(aValue);
+		{
+			std::lock_guard<std::mutex> lock(b.mLock);
+		}
+		b.mCondition.notify_all();
+	}
+
+#endif
+}}
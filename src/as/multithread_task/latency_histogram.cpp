@@ -0,0 +1,87 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/latency_histogram.hpp"
+
+namespace as {
+	// latency_histogram
+
+	latency_histogram::latency_histogram() throw() {
+		for(uint64_t& i : mBuckets) i = 0;
+	}
+
+	size_t latency_histogram::get_bucket_index(uint64_t aNanoseconds) throw() {
+		if(aNanoseconds == 0) return 0;
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<size_t>(63 - __builtin_clzll(aNanoseconds));
+#else
+		size_t tmp = 0;
+		while(aNanoseconds >>= 1) ++tmp;
+		return tmp;
+#endif
+	}
+
+	void latency_histogram::add(std::chrono::nanoseconds aDuration) throw() {
+		++mBuckets[get_bucket_index(aDuration.count() > 0 ? static_cast<uint64_t>(aDuration.count()) : 0)];
+	}
+
+	void latency_histogram::merge(const latency_histogram& aOther) throw() {
+		for(size_t i = 0; i < BUCKET_COUNT; ++i) mBuckets[i] += aOther.mBuckets[i];
+	}
+
+	void latency_histogram::set_bucket(size_t aBucket, uint64_t aCount) throw() {
+		mBuckets[aBucket] = aCount;
+	}
+
+	uint64_t latency_histogram::get_bucket(size_t aBucket) const throw() {
+		return mBuckets[aBucket];
+	}
+
+	uint64_t latency_histogram::get_count() const throw() {
+		uint64_t tmp = 0;
+		for(uint64_t i : mBuckets) tmp += i;
+		return tmp;
+	}
+
+	std::chrono::nanoseconds latency_histogram::get_percentile(double aPercentile) const throw() {
+		const uint64_t count = get_count();
+		if(count == 0) return std::chrono::nanoseconds(0);
+
+		const double target = aPercentile / 100.0 * static_cast<double>(count);
+		uint64_t seen = 0;
+		for(size_t i = 0; i < BUCKET_COUNT; ++i) {
+			seen += mBuckets[i];
+			if(seen > 0 && static_cast<double>(seen) >= target) return std::chrono::nanoseconds(i >= 62 ? INT64_MAX : (static_cast<int64_t>(2) << i) - 1);
+		}
+		return std::chrono::nanoseconds(INT64_MAX);
+	}
+
+	namespace implementation {
+		// atomic_histogram
+
+		atomic_histogram::atomic_histogram() throw() {
+			for(std::atomic<uint64_t>& i : mBuckets) i.store(0, std::memory_order_relaxed);
+		}
+
+		void atomic_histogram::add(uint64_t aNanoseconds) throw() {
+			mBuckets[latency_histogram::get_bucket_index(aNanoseconds)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void atomic_histogram::add_to(latency_histogram& aHistogram) const throw() {
+			for(size_t i = 0; i < latency_histogram::BUCKET_COUNT; ++i) {
+				aHistogram.set_bucket(i, aHistogram.get_bucket(i) + mBuckets[i].load(std::memory_order_relaxed));
+			}
+		}
+	}
+}
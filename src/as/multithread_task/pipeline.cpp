@@ -0,0 +1,317 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/pipeline.hpp"
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include "as/multithread_task/futex.hpp"
+#include "as/multithread_task/task.hpp"
+#include "as/multithread_task/task_allocator.hpp"
+
+namespace as {
+
+	struct pipeline::state : public std::enable_shared_from_this<state> {
+		enum : size_t {
+			NO_TOKEN = SIZE_MAX		//!< Marks an empty slot.
+		};
+
+		struct token {
+			uint64_t mSequence;		//!< The position of the item in the stream.
+			bool mFailed;			//!< Set if the item was discarded, later stages skip it.
+		};
+
+		struct serial_stage {
+			std::mutex mLock;				//!< Thread-safe access to the other members.
+			std::vector<size_t> mParked;	//!< In order stages: the token of each parked item, indexed by sequence modulo the token count.
+			std::deque<size_t> mQueue;		//!< Out of order stages: the tokens of the parked items.
+			uint64_t mNext;					//!< In order stages: the sequence of the next item to process.
+			bool mBusy;						//!< Set while an item is being processed by the stage.
+		};
+
+		/*!
+			\brief Carries an item through the pipeline, or runs the source if mStage is 0.
+		*/
+		class stage_task : public task<void> {
+		private:
+			const std::shared_ptr<pipeline::state> mState;
+			const size_t mToken;
+			const size_t mStage;
+		protected:
+			void on_execute(task_controller&) override {
+				if(mStage == 0) mState->produce(mToken);
+				else mState->process(mToken, mStage, true);
+				set_return();
+			}
+
+			void on_resume(task_controller&, uint8_t) override {}
+		public:
+			stage_task(std::shared_ptr<pipeline::state> aState, size_t aToken, size_t aStage) :
+				mState(std::move(aState)),
+				mToken(aToken),
+				mStage(aStage)
+			{}
+		};
+
+		std::vector<std::unique_ptr<implementation::pipeline_stage>> mStages;	//!< The source followed by the other stages.
+		std::unique_ptr<serial_stage[]> mSerial;		//!< The parked items of each stage, unused for the source and parallel stages.
+		std::vector<token> mTokens;						//!< The item carried by each token.
+		std::vector<size_t> mFree;						//!< The tokens that are not carrying an item.
+		std::mutex mSourceLock;							//!< Thread-safe access to mFree and the source flags.
+		std::mutex mExceptionLock;						//!< Thread-safe access to mException.
+		std::exception_ptr mException;					//!< The first exception thrown by a stage.
+		task_dispatcher* mDispatcher;					//!< The dispatcher that the pipeline was last scheduled with.
+		uint64_t mProduced;								//!< The number of items produced by the source during the current execution.
+		std::atomic<uint32_t> mPending;					//!< The number of items in flight, plus one until the source has stopped.
+		std::atomic_bool mCancelled;					//!< Set when a stage throws.
+		const size_t mTokenCount;						//!< The largest number of items in flight.
+		task_dispatcher::priority mPriority;			//!< The priority to schedule tasks with.
+		bool mSourceBusy;								//!< Set while a task is running the source.
+		bool mSourceDone;								//!< Set once the source has stopped.
+
+		state(size_t aTokens) :
+			mDispatcher(nullptr),
+			mProduced(0),
+			mPending(0),
+			mCancelled(false),
+			mTokenCount(aTokens),
+			mPriority(task_dispatcher::priority::PRIORITY_MEDIUM),
+			mSourceBusy(false),
+			mSourceDone(false)
+		{}
+
+		void post(size_t aToken, size_t aStage) {
+			const task_dispatcher::task_ptr task = make_task<stage_task>(shared_from_this(), aToken, aStage);
+			mDispatcher->schedule_bulk(&task, 1, mPriority);
+		}
+
+		void release() throw() {
+			if(mPending.fetch_sub(1, std::memory_order_acq_rel) == 1) implementation::futex_wake_all(mPending);
+		}
+
+		void fail(std::exception_ptr aException) throw() {
+			std::lock_guard<std::mutex> lock(mExceptionLock);
+			if(! mException) mException = aException;
+			mCancelled = true;
+		}
+
+		/*!
+			\brief Start a task for the source if it is idle and a token is free.
+		*/
+		void feed() {
+			size_t token = NO_TOKEN;
+			bool stopped = false;
+			{
+				std::lock_guard<std::mutex> lock(mSourceLock);
+				if(mSourceBusy || mSourceDone) return;
+				if(mCancelled) {
+					mSourceDone = true;
+					stopped = true;
+				}else if(! mFree.empty()) {
+					token = mFree.back();
+					mFree.pop_back();
+					mSourceBusy = true;
+				}
+			}
+			if(stopped) release();
+			else if(token != NO_TOKEN) post(token, 0);
+		}
+
+		void produce(size_t aToken) {
+			bool produced = false;
+			try {
+				produced = mStages[0]->execute(nullptr, aToken);
+			}catch(...) {
+				fail(std::current_exception());
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mSourceLock);
+				mSourceBusy = false;
+				if(produced) {
+					mTokens[aToken].mSequence = mProduced++;
+					mTokens[aToken].mFailed = false;
+					mPending.fetch_add(1, std::memory_order_relaxed);
+				}else {
+					mFree.push_back(aToken);
+					mSourceDone = true;
+				}
+			}
+			if(! produced) {
+				release();
+				return;
+			}
+
+			// Keep the source running on another thread while this one carries the item onwards
+			feed();
+			process(aToken, 1, false);
+		}
+
+		void execute(size_t aToken, size_t aStage) throw() {
+			token& t = mTokens[aToken];
+			implementation::pipeline_stage* const previous = mStages[aStage - 1].get();
+			if(! t.mFailed && mCancelled.load(std::memory_order_relaxed)) {
+				previous->destroy(aToken);
+				t.mFailed = true;
+			}
+			if(t.mFailed) return;
+
+			try {
+				mStages[aStage]->execute(previous, aToken);
+			}catch(...) {
+				t.mFailed = true;
+				fail(std::current_exception());
+			}
+			previous->destroy(aToken);
+		}
+
+		/*!
+			\brief Carry an item through the stages until it has to wait for a serial stage or leaves the pipeline.
+			\param aToken The token carrying the item.
+			\param aStage The next stage to process the item.
+			\param aClaimed True if the item has already been given the stage, which must be serial.
+		*/
+		void process(size_t aToken, size_t aStage, bool aClaimed) {
+			const size_t count = mStages.size();
+			for(; aStage < count; ++aStage) {
+				const implementation::pipeline_mode mode = mStages[aStage]->mMode;
+				if(mode == implementation::PIPELINE_PARALLEL) {
+					execute(aToken, aStage);
+					continue;
+				}
+
+				serial_stage& s = mSerial[aStage];
+				if(! aClaimed) {
+					std::lock_guard<std::mutex> lock(s.mLock);
+					if(mode == implementation::PIPELINE_SERIAL_IN_ORDER && mTokens[aToken].mSequence != s.mNext) {
+						s.mParked[mTokens[aToken].mSequence % mTokenCount] = aToken;
+						return;
+					}else if(s.mBusy) {
+						if(mode == implementation::PIPELINE_SERIAL_IN_ORDER) s.mParked[mTokens[aToken].mSequence % mTokenCount] = aToken;
+						else s.mQueue.push_back(aToken);
+						return;
+					}
+					s.mBusy = true;
+				}
+				aClaimed = false;
+
+				execute(aToken, aStage);
+
+				// Hand the stage straight to the next parked item so that no other item can take it first
+				size_t next = NO_TOKEN;
+				{
+					std::lock_guard<std::mutex> lock(s.mLock);
+					if(mode == implementation::PIPELINE_SERIAL_IN_ORDER) {
+						size_t& slot = s.mParked[++s.mNext % mTokenCount];
+						next = slot;
+						slot = NO_TOKEN;
+					}else if(! s.mQueue.empty()) {
+						next = s.mQueue.front();
+						s.mQueue.pop_front();
+					}
+					if(next == NO_TOKEN) s.mBusy = false;
+				}
+				if(next != NO_TOKEN) post(next, aStage);
+			}
+
+			if(! mTokens[aToken].mFailed) mStages[count - 1]->destroy(aToken);
+			{
+				std::lock_guard<std::mutex> lock(mSourceLock);
+				mFree.push_back(aToken);
+			}
+			feed();
+			release();
+		}
+
+		void wait() throw() {
+			if(mPending.load(std::memory_order_acquire) != 0) mDispatcher->wait(mPending);
+		}
+	};
+
+	// pipeline
+
+	pipeline::pipeline(size_t aTokens) {
+		if(aTokens == 0) throw std::invalid_argument("as::pipeline::pipeline : Token count must be at least 1");
+		mState.reset(new state(aTokens));
+	}
+
+	pipeline::~pipeline() {
+		mState->wait();
+	}
+
+	void pipeline::add_stage(std::unique_ptr<implementation::pipeline_stage> aStage) {
+		if(! is_ready()) throw std::logic_error("as::pipeline : Pipeline cannot be modified while it is executing");
+		mState->mStages.push_back(std::move(aStage));
+	}
+
+	size_t pipeline::get_stage_count() const throw() {
+		return mState->mStages.size();
+	}
+
+	size_t pipeline::get_token_count() const throw() {
+		return mState->mTokenCount;
+	}
+
+	void pipeline::schedule(task_dispatcher& aDispatcher, task_dispatcher::priority aPriority) {
+		if(! is_ready()) throw std::logic_error("as::pipeline::schedule : Pipeline is already executing");
+		state& s = *mState;
+		if(s.mStages.empty()) throw std::logic_error("as::pipeline::schedule : Pipeline has no source");
+
+		const size_t tokens = s.mTokenCount;
+		const size_t stages = s.mStages.size();
+		for(std::unique_ptr<implementation::pipeline_stage>& i : s.mStages) i->reserve(tokens);
+		s.mSerial.reset(new state::serial_stage[stages]);
+		for(size_t i = 1; i < stages; ++i) {
+			state::serial_stage& tmp = s.mSerial[i];
+			if(s.mStages[i]->mMode == implementation::PIPELINE_SERIAL_IN_ORDER) tmp.mParked.assign(tokens, state::NO_TOKEN);
+			tmp.mNext = 0;
+			tmp.mBusy = false;
+		}
+		s.mTokens.assign(tokens, state::token{ 0, false });
+		s.mFree.clear();
+		for(size_t i = tokens; i > 0; --i) s.mFree.push_back(i - 1);
+
+		s.mException = nullptr;
+		s.mCancelled = false;
+		s.mProduced = 0;
+		s.mSourceBusy = false;
+		s.mSourceDone = false;
+		s.mDispatcher = &aDispatcher;
+		s.mPriority = aPriority;
+		s.mPending.store(1, std::memory_order_release);
+		s.feed();
+	}
+
+	void pipeline::wait() {
+		mState->wait();
+		std::exception_ptr exception;
+		{
+			std::lock_guard<std::mutex> lock(mState->mExceptionLock);
+			exception = mState->mException;
+			mState->mException = nullptr;
+		}
+		if(exception) std::rethrow_exception(exception);
+	}
+
+	void pipeline::run(task_dispatcher& aDispatcher, task_dispatcher::priority aPriority) {
+		schedule(aDispatcher, aPriority);
+		wait();
+	}
+
+	bool pipeline::is_ready() const throw() {
+		return mState->mPending.load(std::memory_order_acquire) == 0;
+	}
+}
@@ -0,0 +1,112 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/scratch_arena.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+namespace as {
+	// scratch_arena::block
+
+	char* scratch_arena::block::begin() throw() {
+		return reinterpret_cast<char*>(this + 1);
+	}
+
+	char* scratch_arena::block::end() throw() {
+		return begin() + mSize;
+	}
+
+	// scratch_arena::scope
+
+	scratch_arena::scope::scope(scratch_arena& aArena) throw() :
+		mArena(aArena),
+		mMark(aArena.get_mark())
+	{}
+
+	scratch_arena::scope::~scope() {
+		mArena.rewind(mMark);
+	}
+
+	// scratch_arena
+
+	scratch_arena::scratch_arena() throw() :
+		mFirst(nullptr),
+		mCurrent(nullptr),
+		mPosition(nullptr)
+	{}
+
+	scratch_arena::~scratch_arena() {
+		block* i = mFirst;
+		while(i) {
+			block* const next = i->mNext;
+			std::free(i);
+			i = next;
+		}
+	}
+
+	scratch_arena& scratch_arena::local() throw() {
+		static thread_local scratch_arena tArena;
+		return tArena;
+	}
+
+	void* scratch_arena::allocate_slow(size_t aBytes, size_t aAlignment) {
+		// Move on to the following blocks, which are empty, until one is large enough
+		block* previous = mCurrent;
+		block* next = mCurrent ? mCurrent->mNext : mFirst;
+		while(next && next->mSize < aBytes + aAlignment) {
+			previous = next;
+			next = next->mNext;
+		}
+
+		if(! next) {
+			// Blocks double in size so that the number of blocks grows with the log of the peak usage
+			const size_t size = std::max<size_t>(aBytes + aAlignment, previous ? previous->mSize * 2 : DEFAULT_BLOCK_SIZE);
+			next = static_cast<block*>(std::malloc(sizeof(block) + size));
+			if(! next) throw std::bad_alloc();
+			next->mNext = nullptr;
+			next->mSize = size;
+			if(previous) previous->mNext = next;
+			else mFirst = next;
+		}
+
+		mCurrent = next;
+		mPosition = next->begin();
+		return allocate(aBytes, aAlignment);
+	}
+
+	scratch_arena::mark scratch_arena::get_mark() const throw() {
+		return mark{ mCurrent, mPosition };
+	}
+
+	void scratch_arena::rewind(mark aMark) throw() {
+		if(aMark.mBlock) {
+			mCurrent = aMark.mBlock;
+			mPosition = aMark.mPosition;
+		}else {
+			reset();
+		}
+	}
+
+	void scratch_arena::reset() throw() {
+		mCurrent = mFirst;
+		mPosition = mFirst ? mFirst->begin() : nullptr;
+	}
+
+	size_t scratch_arena::get_capacity() const throw() {
+		size_t tmp = 0;
+		for(block* i = mFirst; i; i = i->mNext) tmp += i->mSize;
+		return tmp;
+	}
+}
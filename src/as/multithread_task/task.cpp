@@ -0,0 +1,81 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/task.hpp"
+
+namespace as { namespace implementation {
+	// task_completion
+
+	task_completion::task_completion() :
+		mFlags(0)
+	{}
+
+	void task_completion::set_ready(uint32_t aFlags) throw() {
+		const uint32_t previous = mFlags.fetch_or(FLAG_READY | aFlags, std::memory_order_acq_rel);
+
+		// Only pay for a system call if somebody is actually blocked
+		if(previous & FLAG_WAITING) futex_wake_all(mFlags);
+	}
+
+	void task_completion::set_value() throw() {
+		set_ready(0);
+	}
+
+	void task_completion::set_exception(std::exception_ptr aException) throw() {
+		mException = aException;
+		set_ready(FLAG_EXCEPTION);
+	}
+
+	void task_completion::reset() throw() {
+		mException = std::exception_ptr();
+		mFlags.store(0, std::memory_order_release);
+	}
+
+	bool task_completion::is_ready() const throw() {
+		return (mFlags.load(std::memory_order_acquire) & FLAG_READY) != 0;
+	}
+
+	bool task_completion::has_exception() const throw() {
+		return (mFlags.load(std::memory_order_acquire) & FLAG_EXCEPTION) != 0;
+	}
+
+	void task_completion::wait() const throw() {
+		std::atomic<uint32_t>& flags = const_cast<std::atomic<uint32_t>&>(mFlags);
+		uint32_t tmp = flags.load(std::memory_order_acquire);
+		while(! (tmp & FLAG_READY)) {
+			if(! (tmp & FLAG_WAITING) && ! flags.compare_exchange_weak(tmp, tmp | FLAG_WAITING, std::memory_order_acquire)) continue;
+			futex_wait(flags, tmp | FLAG_WAITING);
+			tmp = flags.load(std::memory_order_acquire);
+		}
+	}
+
+	std::future_status task_completion::wait_for(std::chrono::nanoseconds aTimeout) const throw() {
+		std::atomic<uint32_t>& flags = const_cast<std::atomic<uint32_t>&>(mFlags);
+		const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + aTimeout;
+		uint32_t tmp = flags.load(std::memory_order_acquire);
+		while(! (tmp & FLAG_READY)) {
+			const std::chrono::nanoseconds remaining = end - std::chrono::steady_clock::now();
+			if(remaining.count() <= 0) return std::future_status::timeout;
+			if(! (tmp & FLAG_WAITING) && ! flags.compare_exchange_weak(tmp, tmp | FLAG_WAITING, std::memory_order_acquire)) continue;
+			futex_wait_for(flags, tmp | FLAG_WAITING, remaining);
+			tmp = flags.load(std::memory_order_acquire);
+		}
+		return std::future_status::ready;
+	}
+
+	void task_completion::get() const {
+		wait();
+		if(has_exception()) std::rethrow_exception(mException);
+	}
+}}
@@ -0,0 +1,148 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/task_allocator.hpp"
+
+namespace as { namespace implementation {
+	enum {
+		SIZE_CLASSES = SLAB_MAX_SIZE / SLAB_ALIGNMENT,	//!< The number of different block sizes.
+		SLAB_SIZE = 64 * 1024,							//!< The number of bytes allocated from the global allocator when a size class runs out.
+		REFILL_COUNT = 32,								//!< The number of blocks a thread takes from the shared cache at once.
+		THREAD_LIMIT = 256								//!< The number of blocks a thread may keep in each size class before returning some to the shared cache.
+	};
+
+	struct free_block {
+		free_block* mNext;
+	};
+
+	/*!
+		\brief The blocks that are shared by all threads.
+	*/
+	struct shared_cache {
+		free_block* mBlocks[SIZE_CLASSES];
+		std::mutex mLock;
+
+		shared_cache() {
+			for(free_block*& i : mBlocks) i = nullptr;
+		}
+
+		void push(size_t aClass, free_block* aFirst, free_block* aLast) {
+			std::lock_guard<std::mutex> lock(mLock);
+			aLast->mNext = mBlocks[aClass];
+			mBlocks[aClass] = aFirst;
+		}
+
+		free_block* pop(size_t aClass, size_t& aCount) {
+			std::lock_guard<std::mutex> lock(mLock);
+
+			if(! mBlocks[aClass]) {
+				// Carve a new slab into blocks
+				const size_t size = (aClass + 1) * SLAB_ALIGNMENT;
+				const size_t count = SLAB_SIZE / size;
+				char* const slab = static_cast<char*>(::operator new(SLAB_SIZE));
+				for(size_t i = 0; i < count; ++i) {
+					reinterpret_cast<free_block*>(slab + size * i)->mNext = i + 1 == count ? nullptr : reinterpret_cast<free_block*>(slab + size * (i + 1));
+				}
+				mBlocks[aClass] = reinterpret_cast<free_block*>(slab);
+			}
+
+			free_block* const first = mBlocks[aClass];
+			free_block* last = first;
+			aCount = 1;
+			while(aCount < REFILL_COUNT && last->mNext) {
+				last = last->mNext;
+				++aCount;
+			}
+			mBlocks[aClass] = last->mNext;
+			last->mNext = nullptr;
+			return first;
+		}
+	};
+
+	// Slabs are never returned to the global allocator, so the cache is intentionally leaked to keep it valid for threads that exit during static destruction
+	static shared_cache& gSharedCache = *new shared_cache();
+
+	/*!
+		\brief The blocks that are owned by a single thread.
+	*/
+	struct thread_cache {
+		free_block* mBlocks[SIZE_CLASSES];
+		size_t mCounts[SIZE_CLASSES];
+
+		thread_cache() {
+			for(size_t i = 0; i < SIZE_CLASSES; ++i) {
+				mBlocks[i] = nullptr;
+				mCounts[i] = 0;
+			}
+		}
+
+		~thread_cache() {
+			for(size_t i = 0; i < SIZE_CLASSES; ++i) {
+				if(! mBlocks[i]) continue;
+				free_block* last = mBlocks[i];
+				while(last->mNext) last = last->mNext;
+				gSharedCache.push(i, mBlocks[i], last);
+			}
+		}
+
+		void* allocate(size_t aClass) {
+			if(! mBlocks[aClass]) mBlocks[aClass] = gSharedCache.pop(aClass, mCounts[aClass]);
+			free_block* const tmp = mBlocks[aClass];
+			mBlocks[aClass] = tmp->mNext;
+			--mCounts[aClass];
+			return tmp;
+		}
+
+		void deallocate(size_t aClass, void* aPtr) {
+			free_block* const block = static_cast<free_block*>(aPtr);
+			block->mNext = mBlocks[aClass];
+			mBlocks[aClass] = block;
+
+			// Blocks freed by a thread that does not allocate them would otherwise accumulate forever
+			if(++mCounts[aClass] > THREAD_LIMIT) {
+				free_block* last = block;
+				for(size_t i = 1; i < THREAD_LIMIT / 2; ++i) last = last->mNext;
+				mBlocks[aClass] = last->mNext;
+				mCounts[aClass] -= THREAD_LIMIT / 2;
+				gSharedCache.push(aClass, block, last);
+			}
+		}
+	};
+
+	static thread_local thread_cache tThreadCache;
+
+	static bool use_slab(size_t aBytes, size_t aAlignment) throw() {
+		return aBytes > 0 && aBytes <= SLAB_MAX_SIZE && aAlignment <= SLAB_ALIGNMENT;
+	}
+
+	static size_t size_class(size_t aBytes) throw() {
+		return (aBytes - 1) / SLAB_ALIGNMENT;
+	}
+
+	void* slab_allocate(size_t aBytes, size_t aAlignment) {
+		if(use_slab(aBytes, aAlignment)) return tThreadCache.allocate(size_class(aBytes));
+#ifdef __cpp_aligned_new
+		if(aAlignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return ::operator new(aBytes, std::align_val_t(aAlignment));
+#endif
+		return ::operator new(aBytes);
+	}
+
+	void slab_deallocate(void* aPtr, size_t aBytes, size_t aAlignment) throw() {
+		if(use_slab(aBytes, aAlignment)) return tThreadCache.deallocate(size_class(aBytes), aPtr);
+#ifdef __cpp_aligned_new
+		if(aAlignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) return ::operator delete(aPtr, std::align_val_t(aAlignment));
+#endif
+		::operator delete(aPtr);
+	}
+}}
@@ -0,0 +1,32 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/task_dispatcher.hpp"
+#include "as/multithread_task/futex.hpp"
+
+namespace as {
+	// task_dispatcher
+
+	void task_dispatcher::wait(const std::atomic<uint32_t>& aCounter) {
+		help_until(
+			[&aCounter]()->bool {
+				return aCounter.load(std::memory_order_acquire) == 0;
+			},
+			[&aCounter](std::chrono::nanoseconds aSlice)->void {
+				const uint32_t remaining = aCounter.load(std::memory_order_acquire);
+				if(remaining != 0) implementation::futex_wait_for(aCounter, remaining, aSlice);
+			}
+		);
+	}
+}
@@ -0,0 +1,166 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/task_graph.hpp"
+#include <stdexcept>
+
+namespace as {
+	// task_graph::vertex
+
+	task_graph::vertex::vertex(state& aState, task_dispatcher::task_ptr aTask, task_dispatcher::priority aPriority) :
+		mTask(aTask),
+		mState(aState),
+		mPredecessors(0),
+		mReleased(false),
+		mPredecessorCount(0),
+		mPriority(aPriority)
+	{}
+
+	void task_graph::vertex::release() throw() {
+		// A cancelled task may still be scheduled again and complete, its successors have already been released by then
+		if(mReleased.exchange(true, std::memory_order_acq_rel)) return;
+
+		// The graph may be destroyed as soon as mRemaining reaches zero
+		const std::shared_ptr<state> keepAlive = mState.shared_from_this();
+
+		for(vertex* i : mSuccessors) {
+			if(i->mPredecessors.fetch_sub(1, std::memory_order_acq_rel) == 1) mState.mDispatcher->schedule_task(i->mTask, i->mPriority);
+		}
+
+		if(mState.mRemaining.fetch_sub(1, std::memory_order_acq_rel) == 1) implementation::futex_wake_all(mState.mRemaining);
+	}
+
+	void task_graph::vertex::on_complete() throw() {
+		release();
+	}
+
+	void task_graph::vertex::on_cancel() throw() {
+		release();
+	}
+
+	// task_graph::state
+
+	task_graph::state::state() :
+		mDispatcher(nullptr),
+		mRemaining(0)
+	{}
+
+	// task_graph::node
+
+	task_graph::node::node(task_graph& aGraph, vertex& aVertex) :
+		mGraph(&aGraph),
+		mVertex(&aVertex)
+	{}
+
+	task_graph::node task_graph::node::then(task_dispatcher::task_ptr aTask, task_dispatcher::priority aPriority) {
+		vertex& successor = mGraph->get_vertex(aTask, aPriority);
+		mVertex->mSuccessors.push_back(&successor);
+		++successor.mPredecessorCount;
+		return node(*mGraph, successor);
+	}
+
+	task_dispatcher::task_ptr task_graph::node::get_task() const throw() {
+		return mVertex->mTask;
+	}
+
+	// task_graph
+
+	task_graph::task_graph() :
+		mState(new state())
+	{}
+
+	task_graph::~task_graph() {
+		wait();
+	}
+
+	task_graph::vertex& task_graph::get_vertex(task_dispatcher::task_ptr aTask, task_dispatcher::priority aPriority) {
+		if(! is_ready()) throw std::logic_error("as::task_graph : Graph cannot be modified while it is executing");
+
+		const auto i = mState->mLookup.find(aTask.get());
+		if(i != mState->mLookup.end()) return *i->second;
+
+		mState->mVertices.push_back(std::unique_ptr<vertex>(new vertex(*mState, aTask, aPriority)));
+		vertex& tmp = *mState->mVertices.back();
+		mState->mLookup.emplace(aTask.get(), &tmp);
+		return tmp;
+	}
+
+	void task_graph::check_acyclic() const {
+		// Kahn's algorithm, every vertex is visited if and only if there is no cycle
+		std::vector<size_t> predecessors;
+		std::vector<const vertex*> ready;
+		std::unordered_map<const vertex*, size_t> indices;
+		predecessors.reserve(mState->mVertices.size());
+		for(const std::unique_ptr<vertex>& i : mState->mVertices) {
+			indices.emplace(i.get(), predecessors.size());
+			predecessors.push_back(i->mPredecessorCount);
+			if(i->mPredecessorCount == 0) ready.push_back(i.get());
+		}
+
+		size_t visited = 0;
+		while(! ready.empty()) {
+			const vertex* const tmp = ready.back();
+			ready.pop_back();
+			++visited;
+			for(const vertex* i : tmp->mSuccessors) if(--predecessors[indices[i]] == 0) ready.push_back(i);
+		}
+
+		if(visited != mState->mVertices.size()) throw std::invalid_argument("as::task_graph::schedule : Dependencies contain a cycle");
+	}
+
+	task_graph::node task_graph::add(task_dispatcher::task_ptr aTask, task_dispatcher::priority aPriority) {
+		return node(*this, get_vertex(aTask, aPriority));
+	}
+
+	void task_graph::add_edge(task_dispatcher::task_ptr aPredecessor, task_dispatcher::task_ptr aSuccessor) {
+		add(aPredecessor).then(aSuccessor);
+	}
+
+	void task_graph::schedule(task_dispatcher& aDispatcher) {
+		if(! is_ready()) throw std::logic_error("as::task_graph::schedule : Graph is already executing");
+		check_acyclic();
+
+		state& s = *mState;
+		for(std::unique_ptr<vertex>& i : s.mVertices) {
+			if(i->mTask->get_state() != task_interface::STATE_INITIALISED) throw std::logic_error("as::task_graph::schedule : Task has already been executed");
+		}
+		if(s.mVertices.empty()) return;
+
+		// Successors are only read by completing tasks, so the roots can be found from the static counts
+		std::vector<task_dispatcher::task_ptr> roots[task_dispatcher::priority::PRIORITY_HIGH + 1];
+		for(std::unique_ptr<vertex>& i : s.mVertices) if(i->mPredecessorCount == 0) roots[i->mPriority].push_back(i->mTask);
+
+		s.mDispatcher = &aDispatcher;
+		for(std::unique_ptr<vertex>& i : s.mVertices) {
+			i->mPredecessors.store(i->mPredecessorCount, std::memory_order_relaxed);
+			i->mReleased.store(false, std::memory_order_relaxed);
+			task_interface::add_continuation(*i->mTask, *i);
+		}
+		s.mRemaining.store(static_cast<uint32_t>(s.mVertices.size()), std::memory_order_release);
+
+		// Each priority is queued in one batch, highest first
+		for(int i = task_dispatcher::priority::PRIORITY_HIGH; i >= task_dispatcher::priority::PRIORITY_LOW; --i) {
+			if(! roots[i].empty()) aDispatcher.schedule_bulk(roots[i], static_cast<task_dispatcher::priority>(i));
+		}
+	}
+
+	void task_graph::wait() throw() {
+		state& s = *mState;
+		if(s.mRemaining.load(std::memory_order_acquire) != 0) s.mDispatcher->wait(s.mRemaining);
+	}
+
+	bool task_graph::is_ready() const throw() {
+		return mState->mRemaining.load(std::memory_order_acquire) == 0;
+	}
+}
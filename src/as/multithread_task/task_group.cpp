@@ -13,40 +13,56 @@
 // limitations under the License.
 
 #include "as/multithread_task/task_group.hpp"
+#include <algorithm>
 
 namespace as {
 	// task_group
 
+	task_group::task_group() :
+		mDispatcher(nullptr)
+	{}
+
 	task_group::~task_group() {
 		wait();
 	}
 
 	void task_group::wait() {
-		for(std::shared_ptr<task_wrapper>& i : mWrappers) i->wait();
+		// Waiting through the dispatcher executes scheduled tasks rather than blocking, so a worker cannot starve a small pool
+		for(std::shared_ptr<task_wrapper>& i : mWrappers) i->wait(mDispatcher);
 		mWrappers.clear();
 	}
 
 	void task_group::schedule(task_dispatcher& aDispatcher, task_dispatcher::priority aPriority) {
-		for(std::shared_ptr<task_wrapper>& i : mWrappers) i->schedule(aDispatcher, aPriority);
+		mDispatcher = &aDispatcher;
+
+		// Queue the whole group at once rather than taking the queue lock for each task
+		std::vector<task_dispatcher::task_ptr> tasks;
+		tasks.reserve(mWrappers.size());
+		for(std::shared_ptr<task_wrapper>& i : mWrappers) tasks.push_back(i->prepare_schedule());
+		aDispatcher.schedule_bulk(tasks, aPriority);
+	}
+
+	size_t task_group::cancel() {
+		if(! mDispatcher) return 0;
+		size_t tmp = 0;
+		for(std::shared_ptr<task_wrapper>& i : mWrappers) if(i->cancel(*mDispatcher)) ++tmp;
+		return tmp;
 	}
 
-	std::future_status task_group::wait_for_ms(std::chrono::milliseconds aDuration) {
-		while(aDuration.count() > 0) {
-			if(mWrappers.empty()) return std::future_status::ready;
-			const std::chrono::milliseconds oldTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-			const std::future_status tmp = mWrappers.back()->wait_for(aDuration);
+	std::future_status task_group::wait_for_ns(std::chrono::nanoseconds aDuration) {
+		const std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + aDuration;
+		while(! mWrappers.empty()) {
+			const std::chrono::nanoseconds remaining = std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now()), std::chrono::nanoseconds(0));
+			const std::future_status tmp = mWrappers.back()->wait_for(mDispatcher, remaining);
 			if(tmp != std::future_status::ready) return tmp;
 			mWrappers.pop_back();
-			const std::chrono::milliseconds elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()) - oldTime;
-			if(elapsedTime >= aDuration) return std::future_status::timeout;
-			aDuration -= elapsedTime;
 		}
 		return std::future_status::ready;
 	}
 
 	std::future_status task_group::wait_until_ms(std::chrono::milliseconds aDuration) {
 		const std::chrono::milliseconds current = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch());
-		return wait_for_ms(aDuration - current);
+		return wait_for_ns(aDuration - current);
 	}
 
 
@@ -14,6 +14,7 @@
 
 #include "as/multithread_task/task_interface.hpp"
 #include "as/multithread_task/task_controller.hpp"
+#include "as/multithread_task/trace.hpp"
 
 namespace as {
 	// task_interface
@@ -21,7 +22,13 @@ namespace as {
 	task_interface::task_interface() :
 		mState(STATE_INITIALISED),
 		mPauseLocation(0),
-		mPauseRequest(false)
+		mPauseRequest(false),
+		mSuspendRequest(false),
+		mContinuations(nullptr),
+		mScheduleTime(0),
+		mPriority(implementation::PRIORITY_MEDIUM),
+		mQueueTicket(0),
+		mQueueOwner(nullptr)
 	{}
 
 	task_interface::~task_interface() {
@@ -29,76 +36,161 @@ namespace as {
 	}
 
 	task_interface::state task_interface::get_state() const {
-		return mState;
+		return mState.load(std::memory_order_acquire);
 	}
 
 	bool task_interface::should_resume() const {
 		return true;
 	}
 
+	// The task that paused itself during the innermost execution on this thread, it may already be executing on another thread
+	static thread_local const task_interface* tPausedTask = nullptr;
+
 	void task_interface::execute(task_controller& aController) throw() {
+		// Claim the task, this fails if it is not ready or another thread has already started it
+		state expected = mState.load(std::memory_order_acquire);
+		if(expected != STATE_INITIALISED && expected != STATE_PAUSED) return;
+		const bool resuming = expected == STATE_PAUSED;
+		if(! mState.compare_exchange_strong(expected, STATE_EXECUTING, std::memory_order_acq_rel)) return;
+
+		const task_interface* const previous = tPausedTask;
+		tPausedTask = nullptr;
+
 		// Try to execute the function
 		try{
-			// Check if the task has already been paused mid-execution
-			switch(mState) {
-			case STATE_INITIALISED:
-				mState = STATE_EXECUTING;
-				on_execute(aController);
-				break;
-			case STATE_PAUSED:
-				mState = STATE_EXECUTING;
+			if(resuming) {
+				implementation::trace(implementation::TRACE_RESUME, this);
 				on_resume(aController, mPauseLocation);
-				break;
+			}else {
+				implementation::trace(implementation::TRACE_START, this);
+				on_execute(aController);
 			}
 		// Catch an exception
 		}catch(std::exception&) {
 			set_exception(std::current_exception());
 		}
+
+		// Once paused the task may be executing on another thread, so it must not be accessed again
+		const bool paused = tPausedTask == this;
+		tPausedTask = previous;
+		if(paused) return;
+
 		// If the task hasn't been paused then it is now complete
-		if(mState == STATE_EXECUTING) mState = STATE_COMPLETE;
+		if(mSuspendRequest) {
+			mSuspendRequest = false;
+			mState.store(STATE_PAUSED, std::memory_order_release);
+			implementation::trace(implementation::TRACE_PAUSE, this);
+			// Another thread may execute the task as soon as this is called, so it must be the last access
+			on_suspended();
+		}else {
+			mState.store(STATE_COMPLETE, std::memory_order_release);
+			implementation::trace(implementation::TRACE_COMPLETE, this);
+			notify_continuations();
+		}
 	}
 
-	
-
 	bool task_interface::pause(task_controller& aController, uint8_t aLocation) throw() {
-		if(mState != task_interface::STATE_EXECUTING) return false;
-		mPauseRequest = false;
+		if(mSuspendRequest) return false;
+
+		// The task must be paused before it is queued again, as another thread may resume it straight away
+		const uint8_t location = mPauseLocation;
+		mPauseLocation = aLocation;
+		state expected = STATE_EXECUTING;
+		if(! mState.compare_exchange_strong(expected, STATE_PAUSED, std::memory_order_acq_rel)) {
+			mPauseLocation = location;
+			return false;
+		}
+		mPauseRequest.store(false, std::memory_order_relaxed);
+		implementation::trace(implementation::TRACE_PAUSE, this);
+
 		if(aController.on_pause(*this)) {
-			mState = task_interface::STATE_PAUSED;
-			mPauseLocation = aLocation;
+			tPausedTask = this;
 			return true;
 		}else {
+			// The task was not queued, so no other thread can have seen it
+			mState.store(STATE_EXECUTING, std::memory_order_relaxed);
+			mPauseLocation = location;
 			return false;
 		}
 	}
 
+	bool task_interface::suspend() throw() {
+		if(mState.load(std::memory_order_relaxed) != task_interface::STATE_EXECUTING) return false;
+		mSuspendRequest = true;
+		return true;
+	}
+
+	void task_interface::on_suspended() throw() {
+
+	}
+
+	// Marks the list of continuations as closed once the task has completed
+	static implementation::task_continuation* const gContinuationsClosed = reinterpret_cast<implementation::task_continuation*>(static_cast<uintptr_t>(1));
+
+	bool task_interface::add_continuation(task_interface& aTask, implementation::task_continuation& aContinuation) throw() {
+		implementation::task_continuation* head = aTask.mContinuations.load(std::memory_order_acquire);
+		do {
+			if(head == gContinuationsClosed) return false;
+			aContinuation.mNext = head;
+		} while(! aTask.mContinuations.compare_exchange_weak(head, &aContinuation, std::memory_order_acq_rel, std::memory_order_acquire));
+		return true;
+	}
+
+	void task_interface::notify_continuations() throw() {
+		implementation::task_continuation* i = mContinuations.exchange(gContinuationsClosed, std::memory_order_acq_rel);
+		while(i) {
+			// The continuation may destroy itself
+			implementation::task_continuation* const next = i->mNext;
+			i->on_complete();
+			i = next;
+		}
+	}
+
+	void task_interface::notify_cancelled() throw() {
+		implementation::task_continuation* i = mContinuations.load(std::memory_order_acquire);
+		if(i == gContinuationsClosed) return;
+		while(i) {
+			i->on_cancel();
+			i = i->mNext;
+		}
+	}
+
 	bool task_interface::cancel(task_controller& aController) throw() {
-		if(mState != task_interface::STATE_INITIALISED) return false;
-		return aController.on_cancel(*this);
+		if(mState.load(std::memory_order_acquire) != task_interface::STATE_INITIALISED) return false;
+		if(! aController.on_cancel(*this)) return false;
+		implementation::trace(implementation::TRACE_CANCEL, this);
+		return true;
 	}
 
 	bool task_interface::reschedule(task_controller& aController, implementation::task_priority aPriority) throw() {
-		if(mState != task_interface::STATE_INITIALISED) return false;
+		if(mState.load(std::memory_order_acquire) != task_interface::STATE_INITIALISED) return false;
 		return aController.on_reschedule(*this, aPriority);
 	}
 
 	bool task_interface::reinitialise() throw() {
-		if(mState != task_interface::STATE_COMPLETE) return false;
+		if(mState.load(std::memory_order_acquire) != task_interface::STATE_COMPLETE) return false;
 		const bool tmp = on_reinitialise();
 		if(tmp) {
-			mState = STATE_INITIALISED;
 			mPauseLocation = 0;
-			mPauseRequest = false;
+			mPauseRequest.store(false, std::memory_order_relaxed);
+			mSuspendRequest = false;
+			mContinuations.store(nullptr, std::memory_order_relaxed);
+			// Publishes the reset fields to the thread that next executes the task
+			mState.store(STATE_INITIALISED, std::memory_order_release);
 			return true;
 		}
 		return false;
 	}
 
 	bool task_interface::is_pause_requested() const throw() {
-		return mPauseRequest;
+		return mPauseRequest.load(std::memory_order_acquire);
+	}
+
+	implementation::task_priority task_interface::get_scheduled_priority() const throw() {
+		return mPriority;
 	}
 
 	void task_interface::request_pause() throw() {
-		if(mState == STATE_EXECUTING) mPauseRequest = true;
+		if(mState.load(std::memory_order_acquire) == STATE_EXECUTING) mPauseRequest.store(true, std::memory_order_release);
 	}
 }
\ No newline at end of file
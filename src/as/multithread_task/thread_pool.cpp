@@ -12,137 +12,909 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include "as/multithread_task/thread_pool.hpp"
 #include "as/multithread_task/task_controller.hpp"
+#include "as/multithread_task/futex.hpp"
+#include "as/multithread_task/trace.hpp"
 
 namespace as {
+	enum : int64_t {
+		DEFAULT_SPIN_DURATION = 50000,	//!< The default number of nanoseconds an idle worker looks for tasks before parking.
+		PURGE_THRESHOLD = 1024,			//!< The minimum number of stale entries before they are purged from the queues.
+		TIMER_RESOLUTION = 1000000,		//!< The number of nanoseconds in a tick of the timer wheel.
+		DEFAULT_IDLE_TIMEOUT = 10000000000,	//!< The default number of nanoseconds a parked worker above the minimum waits before it retires.
+		MONITOR_INTERVAL = 10000000		//!< The number of nanoseconds tasks wait with every worker busy before compensating threads are added.
+	};
+
+	static int64_t steady_now() throw() {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static int highest_bit(uint32_t aMask) throw() {
+#if defined(__GNUC__) || defined(__clang__)
+		return 31 - __builtin_clz(aMask);
+#else
+		int tmp = 0;
+		while(aMask >>= 1) ++tmp;
+		return tmp;
+#endif
+	}
+
+	// thread_pool::controller
+
+	/*!
+		\brief Gives tasks access to the pool that is executing them.
+	*/
+	class thread_pool::controller : public task_controller {
+	private:
+		thread_pool& mPool;		//!< The pool that is executing the task.
+		worker* const mWorker;	//!< The worker that is executing the task, or nullptr if it is executed by a thread outside of the pool.
+	protected:
+		// Inherited from task_controller
+		bool on_pause(task_interface& aTask) throw() override {
+			counters::add(mPool.get_counters(mWorker).mPauses, 1);
+			if(mPool.mTimingMetrics || mPool.mAgingThreshold != 0) set_schedule_time(aTask, steady_now());
+
+			// Keep the priority the task was scheduled with
+			const priority p = get_priority(aTask);
+			if(mPool.mScheduler == SCHEDULER_WORK_STEALING && mWorker) {
+				std::lock_guard<std::mutex> lock(mWorker->mTasksLock);
+				mPool.push_task(mWorker->mTasks[p], aTask.shared_from_this(), p);
+			}else {
+				mPool.push_injected_task(aTask.shared_from_this(), p);
+			}
+			return true;
+		}
+
+		bool on_cancel(task_interface& aTask) throw() override {
+			const bool timer = mPool.remove_timer(aTask);
+			const bool queued = mPool.remove_task(aTask);
+			if(! queued && ! timer) return false;
+			counters::add(mPool.get_counters(mWorker).mCancels, 1);
+			if(queued || aTask.get_state() == task_interface::STATE_INITIALISED) notify_cancelled(aTask);
+			return true;
+		}
+
+		bool on_reschedule(task_interface& aTask, task_dispatcher::priority aPriority) throw() override {
+			if(! mPool.remove_task(aTask)) return false;
+			counters::add(mPool.get_counters(mWorker).mReschedules, 1);
+			mPool.schedule_task(aTask.shared_from_this(), aPriority);
+			return true;
+		}
+	public:
+		controller(thread_pool& aPool, worker* aWorker) :
+			mPool(aPool),
+			mWorker(aWorker)
+		{}
+
+		task_dispatcher& get_dispatcher() throw() override {
+			return mPool;
+		}
+
+		size_t get_worker_index() const throw() override {
+			return mWorker ? mWorker->mIndex : NO_WORKER;
+		}
+
+		size_t get_worker_count() const throw() override {
+			return mPool.mWorkers.size();
+		}
+	};
+
+	// thread_pool::counters
+
+	thread_pool::counters::counters() :
+		mTasksExecuted(0),
+		mTasksStolen(0),
+		mPauses(0),
+		mCancels(0),
+		mReschedules(0),
+		mBusyTime(0),
+		mIdleTime(0),
+		mParkedTime(0)
+	{}
+
+	void thread_pool::counters::add(std::atomic<uint64_t>& aCounter, uint64_t aValue) throw() {
+		aCounter.fetch_add(aValue, std::memory_order_relaxed);
+	}
+
+	void thread_pool::counters::copy_to(worker_metrics& aMetrics) const throw() {
+		aMetrics.mTasksExecuted = mTasksExecuted.load(std::memory_order_relaxed);
+		aMetrics.mTasksStolen = mTasksStolen.load(std::memory_order_relaxed);
+		aMetrics.mPauses = mPauses.load(std::memory_order_relaxed);
+		aMetrics.mCancels = mCancels.load(std::memory_order_relaxed);
+		aMetrics.mReschedules = mReschedules.load(std::memory_order_relaxed);
+		aMetrics.mBusyTime = std::chrono::nanoseconds(mBusyTime.load(std::memory_order_relaxed));
+		aMetrics.mIdleTime = std::chrono::nanoseconds(mIdleTime.load(std::memory_order_relaxed));
+		aMetrics.mParkedTime = std::chrono::nanoseconds(mParkedTime.load(std::memory_order_relaxed));
+	}
+
+	// thread_pool::worker
+
+	thread_pool::worker::worker(thread_pool& aPool, size_t aIndex) :
+		mRunning(false),
+		mPool(aPool),
+		mIndex(aIndex)
+	{}
+
 	// thread_pool
 
+	thread_local thread_pool::worker* thread_pool::tCurrentWorker = nullptr;
+
 	thread_pool::thread_pool() :
-		mHighPriority(priority::PRIORITY_LOW),
-		mExit(false)
-	{
-		// Create a worker thread for each CPU core
-		const size_t cores = std::thread::hardware_concurrency();
-		for (size_t i = 0; i < cores; ++i) mThreads.push_back(std::thread(&thread_pool::worker_function, this));
-	}
+		// Create a worker for each CPU core
+		thread_pool(std::thread::hardware_concurrency(), std::thread::hardware_concurrency())
+	{}
 
 	thread_pool::thread_pool(size_t aThreads) :
-		mHighPriority(priority::PRIORITY_LOW),
-		mExit(false)
+		thread_pool(aThreads, aThreads)
+	{}
+
+	thread_pool::thread_pool(size_t aThreads, scheduler aScheduler) :
+		thread_pool(aThreads, aThreads, aScheduler)
+	{}
+
+	thread_pool::thread_pool(size_t aThreads, scheduler aScheduler, queue_backend aQueueBackend, size_t aQueueCapacity) :
+		thread_pool(aThreads, aThreads, aScheduler, aQueueBackend, aQueueCapacity)
+	{}
+
+	thread_pool::thread_pool(size_t aMinThreads, size_t aMaxThreads, scheduler aScheduler, queue_backend aQueueBackend, size_t aQueueCapacity) :
+		mWakeEpoch(0),
+		mSleepers(0),
+		mSpinDuration(DEFAULT_SPIN_DURATION),
+		mThreadCount(0),
+		mIdleWorkers(0),
+		mMinThreads(std::min(aMinThreads, aMaxThreads)),
+		mIdleTimeout(DEFAULT_IDLE_TIMEOUT),
+		mMonitoring(false),
+		mBacklogSince(0),
+		mNextMonitor(0),
+		mPriorityMask(0),
+		mAgingThreshold(0),
+		mNextAging(0),
+		mStaleTasks(0),
+		mNextPurge(PURGE_THRESHOLD),
+		mPurging(false),
+		mScheduler(aScheduler),
+		mQueueBackend(aQueueBackend),
+		mExit(false),
+		mTimingMetrics(true),
+		mTimers(steady_now(), std::chrono::nanoseconds(TIMER_RESOLUTION)),
+		mTimerCount(0)
 	{
-		// Create worker threads
-		for(size_t i = 0; i < aThreads; ++i) mThreads.push_back(std::thread(&thread_pool::worker_function, this));
+		create_workers(aMaxThreads, aQueueCapacity);
 	}
 
 	thread_pool::~thread_pool() {
 		mExit = true;
-		mTaskScheduled.notify_all();
-		for(std::thread& i : mThreads) i.join();
+
+		// Taking the lock ensures that the timer thread is either waiting or will see mExit
+		{
+			std::lock_guard<std::mutex> lock(mTimerLock);
+		}
+		mTimerCondition.notify_all();
+		if(mTimerThread.joinable()) mTimerThread.join();
+
+		// No thread is started once the lock has been taken after mExit is set
+		{
+			std::lock_guard<std::mutex> lock(mWorkersLock);
+		}
+		++mWakeEpoch;
+		implementation::futex_wake_all(mWakeEpoch);
+		for(std::unique_ptr<worker>& i : mWorkers) if(i->mThread.joinable()) i->mThread.join();
+	}
+
+	size_t thread_pool::get_min_threads() const throw() {
+		return mMinThreads;
+	}
+
+	size_t thread_pool::get_max_threads() const throw() {
+		return mWorkers.size();
+	}
+
+	size_t thread_pool::get_thread_count() const throw() {
+		return mThreadCount;
+	}
+
+	void thread_pool::set_idle_timeout(std::chrono::nanoseconds aTimeout) throw() {
+		mIdleTimeout = aTimeout.count() > 0 ? aTimeout.count() : 0;
+	}
+
+	std::chrono::nanoseconds thread_pool::get_idle_timeout() const throw() {
+		return std::chrono::nanoseconds(mIdleTimeout.load());
+	}
+
+	thread_pool::scheduler thread_pool::get_scheduler() const throw() {
+		return mScheduler;
+	}
+
+	thread_pool::queue_backend thread_pool::get_queue_backend() const throw() {
+		return mQueueBackend;
+	}
+
+	void thread_pool::set_spin_duration(std::chrono::nanoseconds aDuration) throw() {
+		mSpinDuration = aDuration.count();
+	}
+
+	std::chrono::nanoseconds thread_pool::get_spin_duration() const throw() {
+		return std::chrono::nanoseconds(mSpinDuration.load());
+	}
+
+	void thread_pool::set_timing_metrics(bool aEnabled) throw() {
+		mTimingMetrics = aEnabled;
+	}
+
+	bool thread_pool::get_timing_metrics() const throw() {
+		return mTimingMetrics;
+	}
+
+	void thread_pool::set_aging_threshold(std::chrono::nanoseconds aThreshold) throw() {
+		mAgingThreshold = aThreshold.count() > 0 ? aThreshold.count() : 0;
+	}
+
+	std::chrono::nanoseconds thread_pool::get_aging_threshold() const throw() {
+		return std::chrono::nanoseconds(mAgingThreshold.load());
+	}
+
+	thread_pool::metrics thread_pool::get_metrics() const {
+		metrics tmp;
+		for(int i = 0; i <= priority::PRIORITY_HIGH; ++i) tmp.mQueueDepth[i] = mTaskCount[i];
+		tmp.mTimers = mTimerCount;
+		tmp.mThreads = mThreadCount;
+
+		tmp.mWorkers.resize(mWorkers.size());
+		for(size_t i = 0; i < mWorkers.size(); ++i) {
+			const counters& c = mWorkers[i]->mCounters;
+			c.copy_to(tmp.mWorkers[i]);
+			c.mScheduleToStart.add_to(tmp.mScheduleToStart);
+			c.mRunTime.add_to(tmp.mRunTime);
+		}
+		mExternalCounters.copy_to(tmp.mExternal);
+		mExternalCounters.mScheduleToStart.add_to(tmp.mScheduleToStart);
+		mExternalCounters.mRunTime.add_to(tmp.mRunTime);
+		return tmp;
+	}
+
+	void thread_pool::create_workers(size_t aThreads, size_t aQueueCapacity) {
+		for(std::atomic_size_t& i : mTaskCount) i = 0;
+		for(std::atomic_size_t& i : mTaskSizes) i = 0;
+		if(mQueueBackend == QUEUE_LOCK_FREE) {
+			for(std::unique_ptr<mpmc_queue<queue_entry>>& i : mLockFreeTasks) i.reset(new mpmc_queue<queue_entry>(aQueueCapacity));
+		}
+
+		// Workers may steal from each other as soon as they start, so all of them must exist first
+		for(size_t i = 0; i < aThreads; ++i) mWorkers.push_back(std::unique_ptr<worker>(new worker(*this, i)));
+	}
+
+	bool thread_pool::start_worker() throw() {
+		std::lock_guard<std::mutex> lock(mWorkersLock);
+		if(mExit || mThreadCount >= mWorkers.size()) return false;
+
+		for(std::unique_ptr<worker>& i : mWorkers) {
+			if(i->mRunning.load(std::memory_order_acquire)) continue;
+			try {
+				// The previous thread of the worker has retired, but may not have returned yet
+				if(i->mThread.joinable()) i->mThread.join();
+				i->mRunning = true;
+				++mThreadCount;
+				i->mThread = std::thread(&thread_pool::worker_function, this, std::ref(*i));
+			}catch(...) {
+				if(i->mRunning) {
+					i->mRunning = false;
+					--mThreadCount;
+				}
+				return false;
+			}
+			return true;
+		}
+		return false;
+	}
+
+	void thread_pool::add_workers(size_t aCount) throw() {
+		const uint32_t idle = mIdleWorkers;
+		if(idle >= aCount) return;
+
+		// Threads up to the minimum are started as soon as there is work for them
+		const size_t threads = mThreadCount;
+		const size_t minimum = std::max<size_t>(mMinThreads, 1);
+		if(threads < minimum) {
+			for(size_t i = std::min<size_t>(aCount - idle, minimum - threads); i > 0; --i) if(! start_worker()) break;
+			return;
+		}
+		if(idle != 0 || mMonitoring.load(std::memory_order_relaxed)) return;
+
+		// Every worker is busy, the timer thread decides whether they are falling behind or only working through a short burst
+		try {
+			{
+				std::lock_guard<std::mutex> lock(mTimerLock);
+				if(mMonitoring || mExit) return;
+				const int64_t now = steady_now();
+				mBacklogSince = now;
+				mNextMonitor = now + MONITOR_INTERVAL / 4;
+				mMonitoring = true;
+				if(! mTimerThread.joinable()) mTimerThread = std::thread(&thread_pool::timer_function, this);
+			}
+			mTimerCondition.notify_one();
+		}catch(...) {
+			mMonitoring = false;
+		}
+	}
+
+	void thread_pool::monitor(int64_t aNow) throw() {
+		size_t queued = 0;
+		for(const std::atomic_size_t& i : mTaskCount) queued += i;
+		const size_t threads = mThreadCount;
+		if(queued == 0 || mIdleWorkers != 0 || threads >= mWorkers.size()) {
+			// add_workers starts monitoring again the next time it finds every worker busy
+			mMonitoring = false;
+			return;
+		}
+
+		mNextMonitor = aNow + MONITOR_INTERVAL / 4;
+		if(aNow - mBacklogSince < MONITOR_INTERVAL) return;
+
+		// Give every waiting task a thread, the new threads then have a full interval to catch up before any more are added
+		for(size_t i = std::min(queued, mWorkers.size() - threads); i > 0; --i) if(! start_worker()) break;
+		mBacklogSince = aNow;
+	}
+
+	bool thread_pool::retire_worker(worker& aWorker) {
+		size_t threads = mThreadCount;
+		do {
+			if(threads <= mMinThreads || mExit) return false;
+		} while(! mThreadCount.compare_exchange_weak(threads, threads - 1));
+
+		// Paused tasks may still be in the local queues, they keep their counts and tickets
+		if(mScheduler == SCHEDULER_WORK_STEALING) {
+			std::lock_guard<std::mutex> lock(aWorker.mTasksLock);
+			std::lock_guard<std::mutex> lock2(mTasksLock);
+			for(int i = 0; i <= priority::PRIORITY_HIGH; ++i) {
+				std::deque<queue_entry>& queue = aWorker.mTasks[i];
+				for(queue_entry& j : queue) mTasks[i].push_back(std::move(j));
+				queue.clear();
+			}
+			update_task_sizes();
+		}
+
+		// A task may have been scheduled after this worker stopped being counted as idle
+		if(has_tasks()) wake_workers(1);
+		return true;
+	}
+
+	void thread_pool::add_task_count(priority aPriority, size_t aCount) throw() {
+		if(mTaskCount[aPriority].fetch_add(aCount) == 0) mPriorityMask.fetch_or(1u << aPriority);
+	}
+
+	void thread_pool::remove_task_count(priority aPriority) throw() {
+		if(--mTaskCount[aPriority] == 0) clear_priority(aPriority);
+	}
+
+	void thread_pool::clear_priority(priority aPriority) throw() {
+		// A task may have been counted between the count reaching zero and the bit being cleared
+		mPriorityMask.fetch_and(~(1u << aPriority));
+		if(mTaskCount[aPriority] != 0) mPriorityMask.fetch_or(1u << aPriority);
+	}
+
+	void thread_pool::age_tasks() {
+		const int64_t threshold = mAgingThreshold.load(std::memory_order_relaxed);
+		const int64_t now = steady_now();
+		int64_t next = mNextAging.load(std::memory_order_relaxed);
+		if(now < next || ! mNextAging.compare_exchange_strong(next, now + threshold / 4)) return;
+
+		{
+			std::lock_guard<std::mutex> lock(mTasksLock);
+			age_queues(mTasks, now, threshold, true);
+			update_task_sizes();
+		}
+		if(mScheduler == SCHEDULER_WORK_STEALING) {
+			for(std::unique_ptr<worker>& i : mWorkers) {
+				std::lock_guard<std::mutex> lock(i->mTasksLock);
+				age_queues(i->mTasks, now, threshold, false);
+			}
+		}
+	}
+
+	void thread_pool::age_queues(std::deque<queue_entry>* aQueues, int64_t aNow, int64_t aThreshold, bool aFront) {
+		// Promoted tasks have waited longer than anything scheduled at their new priority, so they go where the next task is taken from
+		size_t promoted[priority::PRIORITY_HIGH + 1] = {};
+
+		// Promoted tasks only move to priorities that have already been checked
+		for(int i = priority::PRIORITY_HIGH - 1; i >= 0; --i) {
+			std::deque<queue_entry>& queue = aQueues[i];
+			while(! queue.empty()) {
+				queue_entry& entry = queue.front();
+				if(! is_ticket_current(*entry.mTask, entry.mTicket)) {
+					queue.pop_front();
+					--mStaleTasks;
+					continue;
+				}
+
+				const int64_t scheduled = get_schedule_time(*entry.mTask);
+				if(scheduled == 0 || aNow <= scheduled) break;
+
+				const int64_t target = std::min<int64_t>(get_priority(*entry.mTask) + (aNow - scheduled) / aThreshold, priority::PRIORITY_HIGH);
+				if(target <= i) break;
+
+				// Count the task at its new priority first so that it is never uncounted
+				const priority p = static_cast<priority>(target);
+				add_task_count(p);
+				if(! move_ticket(*entry.mTask, entry.mTicket, p)) {
+					// The task was cancelled in the meantime, which has already uncounted it
+					remove_task_count(p);
+					queue.pop_front();
+					--mStaleTasks;
+					continue;
+				}
+
+				if(aFront) {
+					aQueues[p].insert(aQueues[p].begin() + promoted[p], std::move(entry));
+					++promoted[p];
+				}else {
+					aQueues[p].push_back(std::move(entry));
+				}
+				queue.pop_front();
+				remove_task_count(static_cast<priority>(i));
+			}
+		}
+	}
+
+	bool thread_pool::remove_task(task_interface& aTask) throw() {
+		priority p;
+		if(! claim_queued(aTask, p)) return false;
+		remove_task_count(p);
+		add_stale_task();
+		return true;
+	}
+
+	void thread_pool::add_stale_task() {
+		const size_t stale = ++mStaleTasks;
+		if(stale < mNextPurge.load(std::memory_order_relaxed) || mPurging.exchange(true)) return;
+
+		{
+			std::lock_guard<std::mutex> lock(mTasksLock);
+			purge_queues(mTasks);
+			update_task_sizes();
+		}
+		if(mScheduler == SCHEDULER_WORK_STEALING) {
+			for(std::unique_ptr<worker>& i : mWorkers) {
+				std::lock_guard<std::mutex> lock(i->mTasksLock);
+				purge_queues(i->mTasks);
+			}
+		}
+
+		// Entries in the lock-free queues cannot be purged, so wait for as many new stale entries as were scanned before purging again
+		size_t queued = 0;
+		for(const std::atomic_size_t& i : mTaskCount) queued += i;
+		mNextPurge = (mStaleTasks + queued) * 2 + PURGE_THRESHOLD;
+		mPurging = false;
+	}
+
+	void thread_pool::purge_queues(std::deque<queue_entry>* aQueues) throw() {
+		for(int i = 0; i <= priority::PRIORITY_HIGH; ++i) {
+			std::deque<queue_entry>& queue = aQueues[i];
+			const auto end = std::remove_if(queue.begin(), queue.end(), [](const queue_entry& aEntry)->bool {
+				return ! is_ticket_current(*aEntry.mTask, aEntry.mTicket);
+			});
+			mStaleTasks -= static_cast<size_t>(queue.end() - end);
+			queue.erase(end, queue.end());
+		}
+	}
+
+	void thread_pool::push_task(std::deque<queue_entry>& aQueue, task_ptr aTask, priority aPriority) {
+		// Count the task first so that a cancel never uncounts it before it is counted
+		add_task_count(aPriority);
+		const uint32_t ticket = enqueue_ticket(*aTask, aPriority);
+		aQueue.push_back(queue_entry{ std::move(aTask), ticket });
+	}
+
+	thread_pool::task_ptr thread_pool::pop_task(std::deque<queue_entry>& aQueue, priority aPriority, bool aBack) {
+		// Check each task at most once so that a queue of paused tasks cannot loop forever
+		const size_t size = aQueue.size();
+		for(size_t i = 0; i < size; ++i) {
+			queue_entry tmp;
+			if(aBack) {
+				tmp = std::move(aQueue.back());
+				aQueue.pop_back();
+			}else {
+				tmp = std::move(aQueue.front());
+				aQueue.pop_front();
+			}
+
+			if(! is_ticket_current(*tmp.mTask, tmp.mTicket)) {
+				--mStaleTasks;
+				continue;
+			}
+
+			if(tmp.mTask->get_state() == task_interface::STATE_PAUSED && ! tmp.mTask->should_resume()) {
+				if(aBack) aQueue.push_front(std::move(tmp));
+				else aQueue.push_back(std::move(tmp));
+				continue;
+			}
+
+			if(! claim_ticket(*tmp.mTask, tmp.mTicket)) {
+				--mStaleTasks;
+				continue;
+			}
+
+			remove_task_count(aPriority);
+			return std::move(tmp.mTask);
+		}
+		return task_ptr();
+	}
+
+	void thread_pool::push_injected_task(task_ptr aTask, priority aPriority) {
+		if(mQueueBackend == QUEUE_LOCK_FREE) {
+			// Count the task first so that workers never see a negative count
+			add_task_count(aPriority);
+			const uint32_t ticket = enqueue_ticket(*aTask, aPriority);
+			queue_entry entry{ std::move(aTask), ticket };
+			if(mLockFreeTasks[aPriority]->try_push(entry)) return;
+
+			// The task is already counted and marked as queued
+			std::lock_guard<std::mutex> lock(mTasksLock);
+			mTasks[aPriority].push_back(std::move(entry));
+			update_task_sizes();
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(mTasksLock);
+		push_task(mTasks[aPriority], std::move(aTask), aPriority);
+		update_task_sizes();
+	}
+
+	void thread_pool::push_injected_tasks(const task_ptr* aTasks, size_t aCount, priority aPriority) {
+		// Count the tasks first so that workers never see a negative count
+		add_task_count(aPriority, aCount);
+
+		size_t pushed = 0;
+		if(mQueueBackend == QUEUE_LOCK_FREE) {
+			pushed = mLockFreeTasks[aPriority]->try_push_bulk(aCount, [this, aTasks, aPriority](size_t i)->queue_entry {
+				return queue_entry{ aTasks[i], enqueue_ticket(*aTasks[i], aPriority) };
+			});
+			if(pushed == aCount) return;
+		}
+
+		std::lock_guard<std::mutex> lock(mTasksLock);
+		std::deque<queue_entry>& queue = mTasks[aPriority];
+		for(size_t i = pushed; i < aCount; ++i) queue.push_back(queue_entry{ aTasks[i], enqueue_ticket(*aTasks[i], aPriority) });
+		update_task_sizes();
+	}
+
+	thread_pool::task_ptr thread_pool::pop_injected_task(priority aPriority) {
+		queue_entry entry;
+
+		// Stale entries are discarded here, they cannot be purged while they are in the lock-free queue
+		while(mQueueBackend == QUEUE_LOCK_FREE && mLockFreeTasks[aPriority]->try_pop(entry)) {
+			if(! is_ticket_current(*entry.mTask, entry.mTicket)) {
+				--mStaleTasks;
+				continue;
+			}
+
+			if(entry.mTask->get_state() != task_interface::STATE_PAUSED || entry.mTask->should_resume()) {
+				if(! claim_ticket(*entry.mTask, entry.mTicket)) {
+					--mStaleTasks;
+					continue;
+				}
+				remove_task_count(aPriority);
+				return std::move(entry.mTask);
+			}
+
+			// Leave the paused task for later and look in the overflow queue instead
+			if(! mLockFreeTasks[aPriority]->try_push(entry)) {
+				std::lock_guard<std::mutex> lock(mTasksLock);
+				mTasks[aPriority].push_back(std::move(entry));
+				update_task_sizes();
+			}
+			break;
+		}
+
+		// Most of the time the overflow queue is empty, so the lock is only taken if it has entries
+		if(mQueueBackend == QUEUE_LOCK_FREE && mTaskSizes[aPriority].load(std::memory_order_acquire) == 0) return task_ptr();
+
+		std::lock_guard<std::mutex> lock(mTasksLock);
+		task_ptr task = pop_task(mTasks[aPriority], aPriority, false);
+		update_task_sizes();
+		return task;
+	}
+
+	void thread_pool::update_task_sizes() throw() {
+		for(int i = 0; i <= priority::PRIORITY_HIGH; ++i) mTaskSizes[i].store(mTasks[i].size(), std::memory_order_release);
+	}
+
+	thread_pool::task_ptr thread_pool::pop_task(worker* aWorker) {
+		task_ptr task;
+		if(mAgingThreshold.load(std::memory_order_relaxed) != 0) age_tasks();
+
+		// Only move to a lower priority once no queue in the pool has a task at the current one
+		const size_t workers = mWorkers.size();
+		uint32_t mask = mPriorityMask;
+		while(mask != 0) {
+			const int i = highest_bit(mask);
+			mask &= ~(1u << i);
+			const priority p = static_cast<priority>(i);
+			if(mTaskCount[i] == 0) {
+				clear_priority(p);
+				continue;
+			}
+
+			// Newest local task first, its data is the most likely to still be in the cache
+			if(mScheduler == SCHEDULER_WORK_STEALING && aWorker) {
+				std::lock_guard<std::mutex> lock(aWorker->mTasksLock);
+				task = pop_task(aWorker->mTasks[i], p, true);
+			}
+			if(task) return task;
+
+			// Tasks scheduled from outside of the pool
+			task = pop_injected_task(p);
+			if(task) return task;
+			if(mScheduler != SCHEDULER_WORK_STEALING) continue;
+
+			// Steal the oldest task from another worker
+			const size_t first = aWorker ? aWorker->mIndex + 1 : 0;
+			for(size_t j = 0; j < workers; ++j) {
+				worker& victim = *mWorkers[(first + j) % workers];
+				if(&victim == aWorker || ! victim.mRunning.load(std::memory_order_relaxed)) continue;
+				{
+					std::lock_guard<std::mutex> lock(victim.mTasksLock);
+					task = pop_task(victim.mTasks[i], p, false);
+				}
+				if(task) {
+					counters::add(get_counters(aWorker).mTasksStolen, 1);
+					return task;
+				}
+			}
+		}
+		return task;
 	}
 
 	void thread_pool::schedule_task(task_ptr aTask, priority aPriority) {
+		if(mTimingMetrics || mAgingThreshold != 0) set_schedule_time(*aTask, steady_now());
+		set_priority(*aTask, aPriority);
+		implementation::trace(implementation::TRACE_SCHEDULE, aTask.get(), static_cast<uint8_t>(aPriority));
+
 		// Add the task to the queue
-		mTasksLock.lock();
-		mHighPriority = aPriority > mHighPriority ? aPriority : mHighPriority;
-		mTasks[aPriority].push_back(aTask);
-		mTasksLock.unlock();
-
-		// Notify a waiting worker that a task has been added
-		mTaskScheduled.notify_one();
-	}
-
-	void thread_pool::worker_function() {
-		const auto pop_task = [this]()->task_ptr {
-			for(int i = mHighPriority; i >= 0; --i) {
-				uint8_t non_resumed = 0;
-				mHighPriority = static_cast<priority>(i);
-				if(non_resumed < mTasks[i].size()) {
-					task_ptr tmp;
-					GET_TASK:
-					tmp.swap(mTasks[i].front());
-					mTasks[i].pop_front();
-					if(tmp->get_state() == task_interface::STATE_PAUSED && ! tmp->should_resume()) {
-						mTasks[i].push_back(tmp);
-						++non_resumed;
-						goto GET_TASK;
-					}
-					return tmp;
+		worker* const local = tCurrentWorker;
+		if(mScheduler == SCHEDULER_WORK_STEALING && local && &local->mPool == this) {
+			std::lock_guard<std::mutex> lock(local->mTasksLock);
+			push_task(local->mTasks[aPriority], aTask, aPriority);
+		}else {
+			push_injected_task(aTask, aPriority);
+		}
+
+		wake_workers(1);
+	}
+
+	void thread_pool::schedule_tasks(const task_ptr* aTasks, size_t aCount, priority aPriority) {
+		if(aCount == 0) return;
+
+		const int64_t now = mTimingMetrics || mAgingThreshold != 0 ? steady_now() : 0;
+		for(size_t i = 0; i < aCount; ++i) {
+			if(now != 0) set_schedule_time(*aTasks[i], now);
+			set_priority(*aTasks[i], aPriority);
+			implementation::trace(implementation::TRACE_SCHEDULE, aTasks[i].get(), static_cast<uint8_t>(aPriority));
+		}
+
+		worker* const local = tCurrentWorker;
+		if(mScheduler == SCHEDULER_WORK_STEALING && local && &local->mPool == this) {
+			std::lock_guard<std::mutex> lock(local->mTasksLock);
+			for(size_t i = 0; i < aCount; ++i) push_task(local->mTasks[aPriority], aTasks[i], aPriority);
+		}else {
+			push_injected_tasks(aTasks, aCount, aPriority);
+		}
+
+		wake_workers(aCount);
+	}
+
+	void thread_pool::schedule_after(task_ptr aTask, std::chrono::nanoseconds aDelay, priority aPriority) {
+		const int64_t now = steady_now();
+		add_timer(std::move(aTask), aDelay.count() > 0 ? now + aDelay.count() : now, 0, aPriority);
+	}
+
+	void thread_pool::schedule_at(task_ptr aTask, std::chrono::steady_clock::time_point aTime, priority aPriority) {
+		add_timer(std::move(aTask), std::chrono::duration_cast<std::chrono::nanoseconds>(aTime.time_since_epoch()).count(), 0, aPriority);
+	}
+
+	void thread_pool::schedule_every(task_ptr aTask, std::chrono::nanoseconds aPeriod, priority aPriority) {
+		if(aPeriod.count() <= 0) throw std::invalid_argument("as::thread_pool::schedule_every : Period must be positive");
+		add_timer(std::move(aTask), steady_now() + aPeriod.count(), aPeriod.count(), aPriority);
+	}
+
+	void thread_pool::add_timer(task_ptr aTask, int64_t aDeadline, int64_t aPeriod, priority aPriority) {
+		const int64_t now = steady_now();
+
+		// A task that is already due does not need to wait for the timer thread
+		if(aPeriod == 0 && aDeadline <= now) {
+			remove_timer(*aTask);
+			schedule_task(std::move(aTask), aPriority);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mTimerLock);
+			mTimers.add(std::move(aTask), aDeadline, aPeriod, aPriority, now);
+			mTimerCount = mTimers.size();
+			if(! mTimerThread.joinable()) mTimerThread = std::thread(&thread_pool::timer_function, this);
+		}
+		mTimerCondition.notify_one();
+	}
+
+	bool thread_pool::remove_timer(const task_interface& aTask) throw() {
+		if(mTimerCount == 0) return false;
+		std::lock_guard<std::mutex> lock(mTimerLock);
+		const bool tmp = mTimers.remove(aTask);
+		mTimerCount = mTimers.size();
+		return tmp;
+	}
+
+	void thread_pool::timer_function() {
+		std::vector<implementation::timer_wheel::expired_timer> expired;
+		std::unique_lock<std::mutex> lock(mTimerLock);
+		while(! mExit) {
+			const int64_t now = steady_now();
+			if(mMonitoring && now >= mNextMonitor) {
+				monitor(now);
+				continue;
+			}
+
+			const int64_t next = std::min(mTimers.get_next_deadline(), mMonitoring ? mNextMonitor : INT64_MAX);
+			if(next > now) {
+				if(next == INT64_MAX) {
+					mTimerCondition.wait(lock);
+				}else {
+					mTimerCondition.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(next))));
 				}
+				continue;
 			}
-			return task_ptr();
-		};
-
-		class controller_t : public task_controller {
-		private:
-			thread_pool& mPool;
-		protected:
-			// Inherited from task_controller
-			bool on_pause(task_interface& aTask) throw() override {
-				mPool.mTasksLock.lock();
-				mPool.mTasks[priority::PRIORITY_LOW].push_back(aTask.shared_from_this());
-				mPool.mTasksLock.unlock();
-				return true;
-			}
-
-			bool on_cancel(task_interface& aTask) throw() override {
-				const task_ptr ptr = aTask.shared_from_this();
-
-				mPool.mTasksLock.lock();
-				for(int i = mPool.mHighPriority; i >= 0; --i) {
-					auto end = mPool.mTasks[i].end();
-					for(auto j = mPool.mTasks[i].begin(); j != end; ++j) {
-						if(*j == ptr) {
-							mPool.mTasks[i].erase(j);
-							mPool.mTasksLock.unlock();
-							return true;
-						}
+
+			mTimers.advance(now, expired);
+			mTimerCount = mTimers.size();
+
+			// Schedule without the lock so that timers can be added and cancelled in the meantime
+			lock.unlock();
+			for(implementation::timer_wheel::expired_timer& i : expired) {
+				if(i.mPeriodic) {
+					// Skip this period if the previous one has not finished
+					const task_interface::state state = i.mTask->get_state();
+					if(state == task_interface::STATE_COMPLETE) {
+						if(! i.mTask->reinitialise()) continue;
+					}else if(state != task_interface::STATE_INITIALISED || is_queued(*i.mTask)) {
+						continue;
 					}
 				}
-				mPool.mTasksLock.unlock();
-				return false;
+				schedule_task(std::move(i.mTask), i.mPriority);
 			}
+			expired.clear();
+			lock.lock();
+		}
+	}
 
-			bool on_reschedule(task_interface& aTask, task_dispatcher::priority aPriority) throw()override {
-				if(! on_cancel(aTask)) return false;
-				mPool.mTasksLock.lock();
-				mPool.mHighPriority = aPriority > mPool.mHighPriority ? aPriority : mPool.mHighPriority;
-				mPool.mTasks[aPriority].push_back(aTask.shared_from_this());
-				mPool.mTasksLock.unlock();
-				return true;
+	thread_pool::counters& thread_pool::get_counters(worker* aWorker) throw() {
+		return aWorker ? aWorker->mCounters : mExternalCounters;
+	}
+
+	void thread_pool::execute_task(task_interface& aTask, task_controller& aController, counters& aCounters) {
+		counters::add(aCounters.mTasksExecuted, 1);
+		// Release the task's scratch memory afterwards, a task executed while waiting keeps the memory of the task that waits
+		const scratch_arena::scope scratch(scratch_arena::local());
+		if(! mTimingMetrics) {
+			aTask.execute(aController);
+			return;
+		}
+
+		const int64_t begin = steady_now();
+		const int64_t scheduled = get_schedule_time(aTask);
+		if(scheduled != 0 && begin >= scheduled) aCounters.mScheduleToStart.add(static_cast<uint64_t>(begin - scheduled));
+
+		aTask.execute(aController);
+
+		const uint64_t duration = static_cast<uint64_t>(steady_now() - begin);
+		aCounters.mRunTime.add(duration);
+		counters::add(aCounters.mBusyTime, duration);
+	}
+
+	bool thread_pool::has_tasks() const throw() {
+		for(const std::atomic_size_t& i : mTaskCount) if(i != 0) return true;
+		return false;
+	}
+
+	void thread_pool::wake_workers(size_t aCount) throw() {
+		// The task count was incremented before this, and a parking worker increments mSleepers before checking the count,
+		// so with both sequentially consistent either the worker sees the task or this sees the worker
+		const uint32_t sleepers = mSleepers;
+		if(sleepers != 0) {
+			++mWakeEpoch;
+			if(aCount == 1) implementation::futex_wake_one(mWakeEpoch);
+			else implementation::futex_wake(mWakeEpoch, static_cast<uint32_t>(std::min<size_t>(aCount, sleepers)));
+		}
+
+		if(mThreadCount.load(std::memory_order_relaxed) < mWorkers.size()) add_workers(aCount);
+	}
+
+	thread_pool::task_ptr thread_pool::idle(worker& aWorker, bool& aExpired) {
+		const bool timing = mTimingMetrics;
+		const int64_t begin = timing ? steady_now() : 0;
+		task_ptr task;
+		++mIdleWorkers;
+
+		// Spin briefly, then give up the time slice, before paying for a sleep and a wake
+		const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now() + std::chrono::nanoseconds(mSpinDuration.load(std::memory_order_relaxed));
+		for(uint32_t i = 0; ! task && ! mExit && std::chrono::steady_clock::now() < end; ++i) {
+			if(has_tasks()) task = pop_task(&aWorker);
+			if(i >= 64) std::this_thread::yield();
+		}
+
+		if(! task && ! mExit) {
+			// Only threads above the minimum can retire, so the others do not need to time out
+			const bool retire = mThreadCount > mMinThreads;
+			const int64_t parked = timing || retire ? steady_now() : 0;
+			const uint32_t epoch = mWakeEpoch;
+			++mSleepers;
+			if(has_tasks()) {
+				// The queued tasks may all be paused, so check again once they have had a chance to become ready
+				implementation::futex_wait_for(mWakeEpoch, epoch, std::chrono::milliseconds(1));
+			}else if(! mExit) {
+				if(retire) {
+					const int64_t timeout = mIdleTimeout.load(std::memory_order_relaxed);
+					implementation::futex_wait_for(mWakeEpoch, epoch, std::chrono::nanoseconds(timeout));
+					aExpired = mWakeEpoch == epoch && steady_now() - parked >= timeout;
+				}else {
+					implementation::futex_wait(mWakeEpoch, epoch);
+				}
 			}
-		public:
-			controller_t(thread_pool& aPool) :
-				mPool(aPool)
-			{}
-		};
+			--mSleepers;
+			if(timing) counters::add(aWorker.mCounters.mParkedTime, static_cast<uint64_t>(steady_now() - parked));
+		}
+
+		--mIdleWorkers;
+		if(timing) counters::add(aWorker.mCounters.mIdleTime, static_cast<uint64_t>(steady_now() - begin));
+		return task;
+	}
+
+	bool thread_pool::cancel(task_interface& aTask) throw() {
+		// A periodic task keeps its timer while it is executing
+		const bool timer = remove_timer(aTask);
+		// A paused task is queued the same way as one that has not started, so its entry is left behind in the same way
+		const task_interface::state state = aTask.get_state();
+		const bool queued = (state == task_interface::STATE_INITIALISED || state == task_interface::STATE_PAUSED) && remove_task(aTask);
+		if(! queued && ! timer) return false;
+
+		worker* const local = tCurrentWorker && &tCurrentWorker->mPool == this ? tCurrentWorker : nullptr;
+		counters::add(get_counters(local).mCancels, 1);
+		implementation::trace(implementation::TRACE_CANCEL, &aTask);
+		// A periodic task that only lost its timer will still complete, so its continuations are not told
+		if(queued || state == task_interface::STATE_INITIALISED) notify_cancelled(aTask);
+		return true;
+	}
 
-		controller_t controller(*this);
+	bool thread_pool::execute_scheduled_task() {
+		worker* const local = tCurrentWorker && &tCurrentWorker->mPool == this ? tCurrentWorker : nullptr;
+		const task_ptr task = pop_task(local);
+		if(! task) return false;
+
+		controller controller(*this, local);
+		execute_task(*task, controller, get_counters(local));
+		return true;
+	}
+
+	void thread_pool::worker_function(worker& aWorker) {
+		tCurrentWorker = &aWorker;
+
+		controller controller(*this, &aWorker);
 
 		while(! mExit) {
-			// Wait for task to be added
-			{
-				std::unique_lock<std::mutex> lock(mTasksLock);
-				mTaskScheduled.wait(lock);
-			}
-			if(mExit) break;
-
-			// Execute the task
-			task_ptr task;
-			mTasksLock.lock();
-			task.swap(pop_task());
-			mTasksLock.unlock();
-			if(task) task->execute(controller);
-
-			// Check if there are more tasks before waiting again
-			do {
-				task.swap(task_ptr());
-				mTasksLock.lock();
-				task.swap(pop_task());
-				mTasksLock.unlock();
-				if(task) task->execute(controller);
-			}while(task);
+			// Check the queues before waiting, so that a task scheduled while every worker was busy is not left behind
+			task_ptr task = pop_task(&aWorker);
+			if(! task) {
+				bool expired = false;
+				task = idle(aWorker, expired);
+				if(! task && expired && retire_worker(aWorker)) break;
+			}
+			if(task) execute_task(*task, controller, aWorker.mCounters);
 		}
+
+		tCurrentWorker = nullptr;
+		// The worker may be restarted by another thread as soon as this is set
+		aWorker.mRunning.store(false, std::memory_order_release);
 	}
 
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include "as/multithread_task/timer_wheel.hpp"
+
+namespace as { namespace implementation {
+
+	static uint32_t lowest_bit(uint64_t aMask) throw() {
+#if defined(__GNUC__) || defined(__clang__)
+		return static_cast<uint32_t>(__builtin_ctzll(aMask));
+#else
+		uint32_t tmp = 0;
+		while((aMask & 1) == 0) {
+			aMask >>= 1;
+			++tmp;
+		}
+		return tmp;
+#endif
+	}
+
+	// timer_wheel
+
+	timer_wheel::timer_wheel(int64_t aOrigin, std::chrono::nanoseconds aResolution) :
+		mCurrent(0),
+		mOrigin(aOrigin),
+		mResolution(aResolution.count() > 0 ? aResolution.count() : 1)
+	{
+		for(uint32_t i = 0; i <= LEVEL_COUNT; ++i) {
+			for(timer*& j : mSlots[i]) j = nullptr;
+			mOccupied[i] = 0;
+		}
+	}
+
+	size_t timer_wheel::size() const throw() {
+		return mTimers.size();
+	}
+
+	void timer_wheel::link(timer& aTimer) throw() {
+		// Round up so that a timer never expires early
+		const int64_t offset = aTimer.mDeadline - mOrigin;
+		uint64_t tick = offset > 0 ? static_cast<uint64_t>((offset + mResolution - 1) / mResolution) : 0;
+		if(tick < mCurrent) tick = mCurrent;
+
+		// The lowest level whose slot is in the same block as the current tick
+		uint32_t level = 0;
+		while(level < LEVEL_COUNT && (tick >> (LEVEL_BITS * (level + 1))) != (mCurrent >> (LEVEL_BITS * (level + 1)))) ++level;
+		const uint32_t slot = level < LEVEL_COUNT ? static_cast<uint32_t>((tick >> (LEVEL_BITS * level)) & (SLOT_COUNT - 1)) : 0;
+
+		aTimer.mLevel = static_cast<uint8_t>(level);
+		aTimer.mSlot = static_cast<uint8_t>(slot);
+		aTimer.mPrevious = nullptr;
+		aTimer.mNext = mSlots[level][slot];
+		if(aTimer.mNext) aTimer.mNext->mPrevious = &aTimer;
+		mSlots[level][slot] = &aTimer;
+		mOccupied[level] |= static_cast<uint64_t>(1) << slot;
+	}
+
+	void timer_wheel::unlink(timer& aTimer) throw() {
+		if(aTimer.mPrevious) aTimer.mPrevious->mNext = aTimer.mNext;
+		else mSlots[aTimer.mLevel][aTimer.mSlot] = aTimer.mNext;
+		if(aTimer.mNext) aTimer.mNext->mPrevious = aTimer.mPrevious;
+		if(! mSlots[aTimer.mLevel][aTimer.mSlot]) mOccupied[aTimer.mLevel] &= ~(static_cast<uint64_t>(1) << aTimer.mSlot);
+	}
+
+	void timer_wheel::cascade(uint32_t aLevel, uint32_t aSlot) throw() {
+		timer* i = mSlots[aLevel][aSlot];
+		mSlots[aLevel][aSlot] = nullptr;
+		mOccupied[aLevel] &= ~(static_cast<uint64_t>(1) << aSlot);
+		while(i) {
+			timer* const next = i->mNext;
+			link(*i);
+			i = next;
+		}
+	}
+
+	uint64_t timer_wheel::get_next_tick() const throw() {
+		// A slot of a higher level that starts at the current tick has not been moved down yet, so every level must be checked
+		uint64_t tmp = UINT64_MAX;
+		for(uint32_t i = 0; i < LEVEL_COUNT; ++i) {
+			const uint32_t shift = LEVEL_BITS * i;
+			const uint64_t mask = mOccupied[i] & (~static_cast<uint64_t>(0) << ((mCurrent >> shift) & (SLOT_COUNT - 1)));
+			if(mask == 0) continue;
+			const uint64_t block = (mCurrent >> (shift + LEVEL_BITS)) << (shift + LEVEL_BITS);
+			tmp = std::min(tmp, std::max(mCurrent, block | (static_cast<uint64_t>(lowest_bit(mask)) << shift)));
+		}
+
+		// Overflowing timers are checked at the start of each block of the top level
+		if(mOccupied[LEVEL_COUNT] != 0) {
+			const uint64_t block = static_cast<uint64_t>(1) << TOP_BITS;
+			tmp = std::min(tmp, (mCurrent + block - 1) & ~(block - 1));
+		}
+		return tmp;
+	}
+
+	void timer_wheel::add(task_ptr aTask, int64_t aDeadline, int64_t aPeriod, task_priority aPriority, int64_t aNow) {
+		const task_interface* const key = aTask.get();
+		auto i = mTimers.find(key);
+		if(i == mTimers.end()) {
+			// The current tick may be long out of date if the wheel has been empty
+			if(mTimers.empty()) {
+				const int64_t offset = aNow - mOrigin;
+				const uint64_t tick = offset > 0 ? static_cast<uint64_t>(offset / mResolution) : 0;
+				if(tick > mCurrent) mCurrent = tick;
+			}
+			i = mTimers.emplace(key, timer()).first;
+		}else {
+			unlink(i->second);
+		}
+
+		timer& t = i->second;
+		t.mTask = std::move(aTask);
+		t.mDeadline = aDeadline;
+		t.mPeriod = aPeriod;
+		t.mPriority = aPriority;
+		link(t);
+	}
+
+	bool timer_wheel::remove(const task_interface& aTask) throw() {
+		const auto i = mTimers.find(&aTask);
+		if(i == mTimers.end()) return false;
+		unlink(i->second);
+		mTimers.erase(i);
+		return true;
+	}
+
+	int64_t timer_wheel::get_next_deadline() const throw() {
+		const uint64_t tick = get_next_tick();
+		return tick == UINT64_MAX ? INT64_MAX : mOrigin + static_cast<int64_t>(tick) * mResolution;
+	}
+
+	void timer_wheel::advance(int64_t aNow, std::vector<expired_timer>& aExpired) {
+		if(aNow < mOrigin) return;
+		const uint64_t now = static_cast<uint64_t>((aNow - mOrigin) / mResolution);
+
+		for(uint64_t tick = get_next_tick(); tick <= now; tick = get_next_tick()) {
+			mCurrent = tick;
+
+			// Move timers down from the highest level first, as they may land in a lower slot that starts at the same tick
+			if((tick & ((static_cast<uint64_t>(1) << TOP_BITS) - 1)) == 0) cascade(LEVEL_COUNT, 0);
+			for(uint32_t i = LEVEL_COUNT - 1; i > 0; --i) {
+				const uint32_t shift = LEVEL_BITS * i;
+				if((tick & ((static_cast<uint64_t>(1) << shift) - 1)) == 0) cascade(i, static_cast<uint32_t>((tick >> shift) & (SLOT_COUNT - 1)));
+			}
+
+			// Every timer left in the level 0 slot expires at this tick
+			const uint32_t slot = static_cast<uint32_t>(tick & (SLOT_COUNT - 1));
+			timer* i = mSlots[0][slot];
+			mSlots[0][slot] = nullptr;
+			mOccupied[0] &= ~(static_cast<uint64_t>(1) << slot);
+			mCurrent = tick + 1;
+
+			while(i) {
+				timer* const next = i->mNext;
+				if(i->mPeriod > 0) {
+					aExpired.push_back(expired_timer{ i->mTask, i->mPriority, true });
+					// Skip any periods that have already been missed
+					i->mDeadline += i->mPeriod;
+					if(i->mDeadline <= aNow) i->mDeadline += ((aNow - i->mDeadline) / i->mPeriod + 1) * i->mPeriod;
+					link(*i);
+				}else {
+					aExpired.push_back(expired_timer{ std::move(i->mTask), i->mPriority, false });
+					mTimers.erase(aExpired.back().mTask.get());
+				}
+				i = next;
+			}
+		}
+
+		// No timer expires before the next tick, so the ticks in between do not need to be visited
+		if(mCurrent <= now) mCurrent = now + 1;
+	}
+}}
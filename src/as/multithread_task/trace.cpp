@@ -0,0 +1,243 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "as/multithread_task/trace.hpp"
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace as { namespace implementation {
+	enum : uint64_t {
+		TRACE_CAPACITY = 1 << 16	//!< The number of events each thread keeps.
+	};
+
+	/*!
+		\brief A single recorded event.
+		\detail The fields are guarded by a per-slot sequence number so that a reader can detect a slot being overwritten.
+	*/
+	struct trace_slot {
+		std::atomic<uint64_t> mSequence;	//!< 2 * (index + 1) when the slot holds the event at index, odd while it is being written.
+		std::atomic<int64_t> mTime;			//!< steady_clock nanoseconds.
+		std::atomic<uintptr_t> mTask;		//!< The address of the task.
+		std::atomic<uint32_t> mInfo;		//!< The trace_event in the low byte and the priority in the next.
+	};
+
+	/*!
+		\brief The events recorded by a single thread.
+	*/
+	struct trace_buffer {
+		std::unique_ptr<trace_slot[]> mSlots;	//!< The ring buffer.
+		std::atomic<uint64_t> mHead;			//!< The index of the next event, only written by the owning thread.
+		std::atomic<uint64_t> mFirst;			//!< Events before this index have been cleared.
+		const uint32_t mThread;					//!< Identifies the buffer in the output.
+
+		trace_buffer(uint32_t aThread) :
+			mSlots(new trace_slot[TRACE_CAPACITY]),
+			mHead(0),
+			mFirst(0),
+			mThread(aThread)
+		{
+			for(uint64_t i = 0; i < TRACE_CAPACITY; ++i) mSlots[i].mSequence.store(0, std::memory_order_relaxed);
+		}
+	};
+
+	/*!
+		\brief Every buffer that has been created.
+		\detail Buffers are never destroyed, a buffer released by an exiting thread keeps its events and is reused by the next new thread.
+	*/
+	struct trace_registry {
+		std::vector<trace_buffer*> mBuffers;
+		std::vector<trace_buffer*> mFree;
+		std::mutex mLock;
+
+		trace_buffer* acquire() {
+			std::lock_guard<std::mutex> lock(mLock);
+			if(! mFree.empty()) {
+				trace_buffer* const tmp = mFree.back();
+				mFree.pop_back();
+				return tmp;
+			}
+			mBuffers.push_back(new trace_buffer(static_cast<uint32_t>(mBuffers.size())));
+			return mBuffers.back();
+		}
+
+		void release(trace_buffer* aBuffer) {
+			std::lock_guard<std::mutex> lock(mLock);
+			mFree.push_back(aBuffer);
+		}
+	};
+
+	// Leaked so that threads which exit during static destruction can still release their buffers
+	static trace_registry& gTraceRegistry = *new trace_registry();
+
+	/*!
+		\brief Owns the calling thread's buffer.
+	*/
+	struct trace_thread {
+		trace_buffer* mBuffer;
+
+		trace_thread() :
+			mBuffer(nullptr)
+		{}
+
+		~trace_thread() {
+			if(mBuffer) gTraceRegistry.release(mBuffer);
+		}
+	};
+
+	static thread_local trace_thread tTraceThread;
+
+	std::atomic_bool gTraceEnabled(false);
+
+	void trace_record(trace_event aEvent, const task_interface* aTask, uint8_t aPriority) throw() {
+		trace_buffer* buffer = tTraceThread.mBuffer;
+		if(! buffer) {
+			try {
+				buffer = tTraceThread.mBuffer = gTraceRegistry.acquire();
+			}catch(...) {
+				return;
+			}
+		}
+
+		const uint64_t index = buffer->mHead.load(std::memory_order_relaxed);
+		trace_slot& slot = buffer->mSlots[index & (TRACE_CAPACITY - 1)];
+		slot.mSequence.store(index * 2 + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot.mTime.store(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count(), std::memory_order_relaxed);
+		slot.mTask.store(reinterpret_cast<uintptr_t>(aTask), std::memory_order_relaxed);
+		slot.mInfo.store(static_cast<uint32_t>(aEvent) | (static_cast<uint32_t>(aPriority) << 8), std::memory_order_relaxed);
+		slot.mSequence.store(index * 2 + 2, std::memory_order_release);
+		buffer->mHead.store(index + 1, std::memory_order_release);
+	}
+
+	struct trace_copy {
+		int64_t mTime;
+		uintptr_t mTask;
+		uint32_t mInfo;
+		uint32_t mThread;
+	};
+
+	static void write_event(std::ostream& aStream, bool& aFirst, const char* aName, const char* aPhase, const trace_copy& aEvent, int64_t aOrigin, const char* aExtra) {
+		char buffer[320];
+		std::snprintf(buffer, sizeof(buffer), "%s\n{\"name\":\"%s\",\"cat\":\"task\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%u%s}",
+			aFirst ? "" : ",",
+			aName,
+			aPhase,
+			static_cast<double>(aEvent.mTime - aOrigin) / 1000.0,
+			aEvent.mThread,
+			aExtra
+		);
+		aStream << buffer;
+		aFirst = false;
+	}
+}}
+
+namespace as {
+	void set_trace_enabled(bool aEnabled) throw() {
+		implementation::gTraceEnabled = aEnabled;
+	}
+
+	bool is_trace_enabled() throw() {
+		return implementation::gTraceEnabled;
+	}
+
+	void clear_trace() throw() {
+		std::lock_guard<std::mutex> lock(implementation::gTraceRegistry.mLock);
+		for(implementation::trace_buffer* i : implementation::gTraceRegistry.mBuffers) i->mFirst = i->mHead.load();
+	}
+
+	void write_chrome_trace(std::ostream& aStream) {
+		using namespace implementation;
+
+		// Copy the events out first so that the buffers are read as quickly as possible
+		std::vector<trace_copy> events;
+		uint32_t threads = 0;
+		{
+			std::lock_guard<std::mutex> lock(gTraceRegistry.mLock);
+			threads = static_cast<uint32_t>(gTraceRegistry.mBuffers.size());
+			for(trace_buffer* i : gTraceRegistry.mBuffers) {
+				const uint64_t head = i->mHead.load(std::memory_order_acquire);
+				uint64_t first = i->mFirst.load();
+				if(head > TRACE_CAPACITY && first < head - TRACE_CAPACITY) first = head - TRACE_CAPACITY;
+
+				for(uint64_t j = first; j < head; ++j) {
+					const trace_slot& slot = i->mSlots[j & (TRACE_CAPACITY - 1)];
+					const uint64_t sequence = slot.mSequence.load(std::memory_order_acquire);
+					if(sequence != j * 2 + 2) continue;
+					trace_copy tmp;
+					tmp.mTime = slot.mTime.load(std::memory_order_relaxed);
+					tmp.mTask = slot.mTask.load(std::memory_order_relaxed);
+					tmp.mInfo = slot.mInfo.load(std::memory_order_relaxed);
+					tmp.mThread = i->mThread;
+					// The slot may have been overwritten while it was being read
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if(slot.mSequence.load(std::memory_order_relaxed) != sequence) continue;
+					events.push_back(tmp);
+				}
+			}
+		}
+
+		int64_t origin = INT64_MAX;
+		for(const trace_copy& i : events) if(i.mTime < origin) origin = i.mTime;
+
+		bool first = true;
+		aStream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+		for(uint32_t i = 0; i < threads; ++i) {
+			char buffer[160];
+			std::snprintf(buffer, sizeof(buffer), "%s\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"Thread %u\"}}", first ? "" : ",", i, i);
+			aStream << buffer;
+			first = false;
+		}
+
+		for(const trace_copy& i : events) {
+			char name[48];
+			char args[96];
+			const unsigned long long task = static_cast<unsigned long long>(i.mTask);
+			const unsigned priority = (i.mInfo >> 8) & 0xFF;
+			std::snprintf(name, sizeof(name), "task 0x%llx", task);
+			std::snprintf(args, sizeof(args), ",\"args\":{\"task\":\"0x%llx\",\"priority\":%u}", task, priority);
+
+			char flow[64];
+			std::snprintf(flow, sizeof(flow), ",\"id\":\"0x%llx\"", task);
+			char flowEnd[80];
+			std::snprintf(flowEnd, sizeof(flowEnd), ",\"id\":\"0x%llx\",\"bp\":\"e\"", task);
+
+			switch(static_cast<trace_event>(i.mInfo & 0xFF)) {
+			case TRACE_SCHEDULE:
+				write_event(aStream, first, "schedule", "i", i, origin, args);
+				write_event(aStream, first, "dispatch", "s", i, origin, flow);
+				break;
+			case TRACE_START:
+				write_event(aStream, first, "dispatch", "f", i, origin, flowEnd);
+				write_event(aStream, first, name, "B", i, origin, args);
+				break;
+			case TRACE_RESUME:
+				write_event(aStream, first, name, "B", i, origin, ",\"args\":{\"resumed\":true}");
+				break;
+			case TRACE_PAUSE:
+				write_event(aStream, first, name, "E", i, origin, ",\"args\":{\"paused\":true}");
+				break;
+			case TRACE_COMPLETE:
+				write_event(aStream, first, name, "E", i, origin, "");
+				break;
+			case TRACE_CANCEL:
+				write_event(aStream, first, "cancel", "i", i, origin, args);
+				break;
+			}
+		}
+		aStream << "\n]}\n";
+	}
+}
@@ -0,0 +1,286 @@
+// Copyright 2017 Adam Smith
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Usage: multithread_task_test
+// Checks the results of the parallel algorithms, pipelines, task graphs and cancellation on a few pool configurations.
+// Failures are printed to stderr and the exit code is the number of failed checks.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "as/multithread_task/thread_pool.hpp"
+#include "as/multithread_task/parallel_reduce.hpp"
+#include "as/multithread_task/parallel_algorithms.hpp"
+#include "as/multithread_task/pipeline.hpp"
+#include "as/multithread_task/task_graph.hpp"
+
+namespace {
+	int gFailures = 0;
+
+	void check(bool aCondition, const char* aTest, const char* aMessage) {
+		if(aCondition) return;
+		std::fprintf(stderr, "%s : %s\n", aTest, aMessage);
+		++gFailures;
+	}
+
+	/*!
+		\brief Occupies every worker of a pool until it is released, so that tasks scheduled in the meantime stay queued.
+	*/
+	class pool_blocker {
+	private:
+		std::atomic_bool mReleased;
+		std::atomic_size_t mBlocked;
+		std::vector<as::task_handle<void>> mHandles;
+	public:
+		pool_blocker(as::thread_pool& aPool, size_t aThreads) :
+			mReleased(false),
+			mBlocked(0)
+		{
+			for(size_t i = 0; i < aThreads; ++i) mHandles.push_back(aPool.submit([this]() {
+				++mBlocked;
+				while(! mReleased) std::this_thread::yield();
+			}));
+			while(mBlocked != aThreads) std::this_thread::yield();
+		}
+
+		~pool_blocker() {
+			release();
+		}
+
+		void release() {
+			mReleased = true;
+			for(const as::task_handle<void>& i : mHandles) i.wait();
+			mHandles.clear();
+		}
+	};
+
+	void test_parallel_reduce(as::thread_pool& aPool) {
+		const int count = 100000;
+		const int64_t expected = static_cast<int64_t>(count) * (count - 1) / 2;
+		const auto add = [](int64_t a, int64_t b)->int64_t { return a + b; };
+		check(as::parallel_reduce(aPool, 0, count, int64_t(0), add) == expected, "parallel_reduce", "Sum of an integral range");
+		check(as::parallel_reduce(aPool, 0, count, int64_t(0), add, as::parallel_for_schedule::dynamic(64)) == expected, "parallel_reduce", "Sum with a dynamic schedule");
+		check(as::parallel_reduce(aPool, 0, count, int64_t(0), add, as::parallel_for_schedule::automatic(), true) == expected, "parallel_reduce", "Sum in deterministic mode");
+		check(as::parallel_reduce(aPool, 5, 5, int64_t(7), add) == 7, "parallel_reduce", "Empty range returns the identity");
+
+		// Concatenation is associative but not commutative, so it fails if partial results are combined out of order
+		std::vector<std::string> letters(2000);
+		for(size_t i = 0; i < letters.size(); ++i) letters[i] = std::string(1, static_cast<char>('a' + i % 26));
+		const std::string joined = std::accumulate(letters.begin(), letters.end(), std::string());
+		const auto concat = [](const std::string& a, const std::string& b)->std::string { return a + b; };
+		check(as::parallel_reduce(aPool, letters.begin(), letters.end(), std::string(), concat, as::parallel_for_schedule::dynamic(7)) == joined, "parallel_reduce", "Concatenation keeps the order of the range");
+		check(as::parallel_reduce(aPool, letters.begin(), letters.end(), std::string(), concat, as::parallel_for_schedule::dynamic(7), true) == joined, "parallel_reduce", "Concatenation in deterministic mode");
+	}
+
+	void test_parallel_scan(as::thread_pool& aPool) {
+		std::vector<int64_t> input(50000);
+		for(size_t i = 0; i < input.size(); ++i) input[i] = static_cast<int64_t>(i % 13) - 6;
+
+		std::vector<int64_t> expected(input.size());
+		std::partial_sum(input.begin(), input.end(), expected.begin());
+		std::vector<int64_t> output(input.size());
+		as::parallel_inclusive_scan(aPool, input.begin(), input.end(), output.begin());
+		check(output == expected, "parallel_scan", "Inclusive scan");
+
+		int64_t sum = 100;
+		for(size_t i = 0; i < input.size(); ++i) {
+			expected[i] = sum;
+			sum += input[i];
+		}
+		as::parallel_exclusive_scan(aPool, input.begin(), input.end(), output.begin(), int64_t(100));
+		check(output == expected, "parallel_scan", "Exclusive scan");
+
+		// In place
+		std::vector<int64_t> tmp = input;
+		std::partial_sum(input.begin(), input.end(), expected.begin());
+		as::parallel_inclusive_scan(aPool, tmp.begin(), tmp.end(), tmp.begin());
+		check(tmp == expected, "parallel_scan", "Inclusive scan in place");
+	}
+
+	/*!
+		\brief A value that cannot be default constructed, so that sorting it cannot rely on a default constructed buffer.
+	*/
+	struct sort_value {
+		int mKey;
+		std::string mText;
+
+		explicit sort_value(int aKey) :
+			mKey(aKey),
+			mText(std::to_string(aKey))
+		{}
+	};
+
+	void test_parallel_sort(as::thread_pool& aPool) {
+		std::mt19937 random(12345);
+		std::vector<int> values(100000);
+		for(int& i : values) i = static_cast<int>(random() % 50000);
+		std::vector<int> expected = values;
+		std::sort(expected.begin(), expected.end());
+
+		std::vector<int> tmp = values;
+		as::parallel_sort(aPool, tmp.begin(), tmp.end());
+		check(tmp == expected, "parallel_sort", "Buffered merge");
+
+		tmp = values;
+		as::parallel_sort(aPool, tmp.begin(), tmp.end(), std::less<>(), true);
+		check(tmp == expected, "parallel_sort", "In place merge");
+
+		tmp = values;
+		as::parallel_sort(aPool, tmp.begin(), tmp.end(), std::less<>(), false, as::parallel_for_schedule::dynamic(1000));
+		check(tmp == expected, "parallel_sort", "Odd number of merge rounds");
+
+		std::vector<sort_value> objects;
+		for(int i : values) objects.emplace_back(i);
+		as::parallel_sort(aPool, objects.begin(), objects.end(), [](const sort_value& a, const sort_value& b)->bool { return a.mKey < b.mKey; });
+		bool sorted = true;
+		for(size_t i = 0; i < objects.size(); ++i) {
+			if(objects[i].mKey != expected[i] || objects[i].mText != std::to_string(expected[i])) sorted = false;
+		}
+		check(sorted, "parallel_sort", "Type without a default constructor");
+	}
+
+	void test_pipeline(as::thread_pool& aPool) {
+		typedef as::pipeline::mode mode;
+		const int items = 2000;
+		for(size_t tokens : { 1, 4, 16 }) {
+			as::pipeline pipeline(tokens);
+			int next = 0;
+			std::atomic_int in_flight(0);
+			std::atomic_int most_in_flight(0);
+			std::vector<int> output;
+			pipeline.source([&](as::pipeline::flow_control& aControl)->int {
+				if(next == items) {
+					aControl.stop();
+					return 0;
+				}
+				const int tmp = ++in_flight;
+				int most = most_in_flight;
+				while(tmp > most && ! most_in_flight.compare_exchange_weak(most, tmp));
+				return next++;
+			})
+			.then(mode::PIPELINE_PARALLEL, [](int aValue)->int { return aValue * 3; })
+			.then(mode::PIPELINE_SERIAL_OUT_OF_ORDER, [](int aValue)->int { return aValue + 1; })
+			.then(mode::PIPELINE_SERIAL_IN_ORDER, [&](int aValue)->void {
+				output.push_back(aValue);
+				--in_flight;
+			});
+			pipeline.run(aPool);
+
+			bool ordered = output.size() == static_cast<size_t>(items);
+			for(size_t i = 0; ordered && i < output.size(); ++i) ordered = output[i] == static_cast<int>(i) * 3 + 1;
+			check(ordered, "pipeline", "Serial in order stage receives items in source order");
+			check(most_in_flight <= static_cast<int>(tokens), "pipeline", "No more items in flight than tokens");
+		}
+	}
+
+	void test_task_graph(as::thread_pool& aPool, size_t aThreads) {
+		// A diamond, each task records its position in the order of execution
+		std::atomic_int clock(0);
+		int order[4] = {};
+		std::vector<as::task_dispatcher::task_ptr> tasks;
+		for(int i = 0; i < 4; ++i) tasks.push_back(as::make_task<as::implementation::callable_task<void>>([&clock, &order, i]() { order[i] = ++clock; }));
+
+		as::task_graph graph;
+		as::task_graph::node root = graph.add(tasks[0]);
+		root.then(tasks[1]).then(tasks[3]);
+		root.then(tasks[2]).then(tasks[3]);
+		graph.schedule(aPool);
+		graph.wait();
+		check(graph.is_ready(), "task_graph", "Graph is ready after wait");
+		check(order[0] == 1 && order[3] == 4 && order[1] > order[0] && order[2] > order[0], "task_graph", "Dependencies are respected");
+
+		// A cancelled node still releases its successors
+		for(as::task_dispatcher::task_ptr& i : tasks) i->reinitialise();
+		clock = 0;
+		{
+			pool_blocker blocker(aPool, aThreads);
+			graph.schedule(aPool);
+			check(aPool.cancel(*tasks[0]), "task_graph", "Root can be cancelled while queued");
+		}
+		graph.wait();
+		check(tasks[0]->get_state() == as::task_interface::STATE_INITIALISED && clock == 3, "task_graph", "Successors of a cancelled node are executed");
+
+		as::task_graph cycle;
+		const as::task_dispatcher::task_ptr a = as::make_task<as::implementation::callable_task<void>>([]() {});
+		const as::task_dispatcher::task_ptr b = as::make_task<as::implementation::callable_task<void>>([]() {});
+		cycle.add(a).then(b).then(a);
+		bool threw = false;
+		try {
+			cycle.schedule(aPool);
+		}catch(std::invalid_argument&) {
+			threw = true;
+		}
+		check(threw, "task_graph", "Cycle is rejected");
+	}
+
+	void test_cancel(as::thread_pool& aPool, size_t aThreads) {
+		std::atomic_int executed(0);
+		std::vector<std::shared_ptr<as::task<void>>> tasks;
+		for(int i = 0; i < 100; ++i) tasks.push_back(as::make_task<as::implementation::callable_task<void>>([&executed]() { ++executed; }));
+
+		std::vector<as::task_handle<void>> handles;
+		int cancelled = 0;
+		{
+			pool_blocker blocker(aPool, aThreads);
+			for(const std::shared_ptr<as::task<void>>& i : tasks) handles.push_back(aPool.schedule_handle<void>(i));
+			for(size_t i = 0; i < tasks.size(); i += 2) if(aPool.cancel(*tasks[i])) ++cancelled;
+			check(! aPool.cancel(*tasks[0]), "cancel", "Task cannot be cancelled twice");
+		}
+		check(cancelled == 50, "cancel", "Every queued task can be cancelled");
+		for(size_t i = 1; i < handles.size(); i += 2) handles[i].wait();
+		check(executed == 50, "cancel", "Cancelled tasks are not executed");
+
+		bool ready = false;
+		for(size_t i = 0; i < handles.size(); i += 2) ready = ready || handles[i].is_ready();
+		check(! ready, "cancel", "Cancelled tasks do not complete");
+
+		// A cancelled task runs if it is scheduled again
+		aPool.schedule_handle<void>(tasks[0]).wait();
+		check(executed == 51, "cancel", "Cancelled task can be scheduled again");
+		check(! aPool.cancel(*tasks[0]), "cancel", "Completed task cannot be cancelled");
+	}
+}
+
+int main() {
+	struct configuration {
+		size_t mThreads;
+		as::thread_pool::scheduler mScheduler;
+		as::thread_pool::queue_backend mQueueBackend;
+	};
+	const configuration configurations[] = {
+		{ 1, as::thread_pool::SCHEDULER_SHARED_QUEUE, as::thread_pool::QUEUE_LOCKED },
+		{ 4, as::thread_pool::SCHEDULER_SHARED_QUEUE, as::thread_pool::QUEUE_LOCK_FREE },
+		{ 4, as::thread_pool::SCHEDULER_WORK_STEALING, as::thread_pool::QUEUE_LOCKED }
+	};
+
+	for(const configuration& i : configurations) {
+		// A small lock-free queue so that the overflow queue is also used
+		as::thread_pool pool(i.mThreads, i.mScheduler, i.mQueueBackend, 64);
+		test_parallel_reduce(pool);
+		test_parallel_scan(pool);
+		test_parallel_sort(pool);
+		test_pipeline(pool);
+		test_task_graph(pool, i.mThreads);
+		test_cancel(pool, i.mThreads);
+	}
+
+	if(gFailures == 0) std::printf("All checks passed\n");
+	return gFailures;
+}